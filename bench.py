@@ -29,9 +29,17 @@ class Args:
     n_samples: list[int]
     n_subqueues: list[int]
     batch_sizes: list[int]
+    leaf_degrees: list[str]
+    idle_futex: list[str]
+    termination_group_sizes: list[str]
     debug: list[str]
+    compressed: list[str]
+    relabel: list[str]
+    page_policies: list[str]
+    numa_policies: list[str]
     algorithms: list[str]
     pin_threads: str
+    cache_dir: str
 
 
 def parse_compilation_flags(kwards):
@@ -69,74 +77,96 @@ def make_rbfs_bod(queue, **kwargs):
     return f"make relax_rbfs_bod QUEUE={queue} " + parse_compilation_flags(kwargs)
 
 
+def make_rbfs_local(queue, **kwargs):
+    return f"make relax_rbfs_local QUEUE={queue} " + parse_compilation_flags(kwargs)
+
+
+def make_rbfs_hybrid(queue, **kwargs):
+    return f"make relax_rbfs_hybrid QUEUE={queue} " + parse_compilation_flags(kwargs)
+
+
 ALGORITHMS = [
     Algorithm(
         "Sequential",
         "Sequential",
         make_sequential_bfs,
         "relax_sequential_bfs",
-        ["DEBUG"],
+        ["DEBUG", "COMPRESSED"],
     ),
-    Algorithm("DO", "DO", make_bfs, "bfs", []),
+    Algorithm("DO", "DO", make_bfs, "bfs", ["COMPRESSED"]),
     Algorithm("DO_TD", "DO_TD", make_bfs, "bfs_td", []),
-    Algorithm("MS", "MS", make_rbfs, "relax_rbfs", ["DEBUG"]),
-    Algorithm("FAA", "FAA", make_rbfs, "relax_rbfs", ["DEBUG"]),
-    Algorithm("FAA_INT", "FAA_INT", make_rbfs, "relax_rbfs", ["DEBUG"]),
+    Algorithm("MS", "MS", make_rbfs, "relax_rbfs", ["DEBUG", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"]),
+    Algorithm("FAA", "FAA", make_rbfs, "relax_rbfs", ["DEBUG", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"]),
+    Algorithm("FAA_INT", "FAA_INT", make_rbfs, "relax_rbfs", ["DEBUG", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"]),
     Algorithm(
         "DCBO_MS",
         "DCBO_MS",
         make_rbfs,
         "relax_rbfs",
-        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES"],
+        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"],
     ),
     Algorithm(
         "DCBO_MS",
         "DCBO_MS_BATCHING",
         make_rbfs_batching,
         "relax_rbfs_batching",
-        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "BATCH_SIZE"],
+        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "BATCH_SIZE", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"],
     ),
     Algorithm(
         "DCBO_FAA",
         "DCBO_FAA",
         make_rbfs,
         "relax_rbfs",
-        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES"],
+        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"],
     ),
     Algorithm(
         "DCBO_FAA",
         "DCBO_FAA_BATCHING",
         make_rbfs_batching,
         "relax_rbfs_batching",
-        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "BATCH_SIZE"],
+        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "BATCH_SIZE", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"],
     ),
     Algorithm(
         "DCBO_FAA",
         "DCBO_FAA_DAD",
         make_rbfs_dad,
         "relax_rbfs_dad",
-        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "BATCH_SIZE"],
+        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "BATCH_SIZE", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"],
     ),
     Algorithm(
         "DCBO_FAA",
         "DCBO_FAA_BOD",
         make_rbfs_bod,
         "relax_rbfs_bod",
-        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "BATCH_SIZE"],
+        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "BATCH_SIZE", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"],
+    ),
+    Algorithm(
+        "DCBO_FAA",
+        "DCBO_FAA_LOCAL",
+        make_rbfs_local,
+        "relax_rbfs_local",
+        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "BATCH_SIZE", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"],
+    ),
+    Algorithm(
+        "DCBO_FAA",
+        "DCBO_FAA_HYBRID",
+        make_rbfs_hybrid,
+        "relax_rbfs_hybrid",
+        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "BATCH_SIZE", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"],
     ),
     Algorithm(
         "DCBO_FAA_INT",
         "DCBO_FAA_INT",
         make_rbfs,
         "relax_rbfs",
-        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES"],
+        ["DEBUG", "N_SAMPLES", "N_SUBQUEUES", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"],
     ),
     Algorithm(
         "FAA_BATCHING",
         "FAA_BATCHING",
         make_rbfs_batching,
         "relax_rbfs_batching",
-        ["DEBUG", "BATCH_SIZE"],
+        ["DEBUG", "BATCH_SIZE", "LEAF_DEGREE", "IDLE_FUTEX", "TERMINATION_GROUP_SIZE", "COMPRESSED"],
     ),
 ]
 
@@ -191,6 +221,30 @@ def parse_args():
         help="List of batch sizes to run algorithms with",
         default=[DEFAULT_BATCH_SIZE],
     )
+    parser.add_argument(
+        "-ld",
+        "--leaf_degrees",
+        nargs="+",
+        type=str,
+        help="List of max degrees for settling leaves without enqueuing them (empty to disable)",
+        default=[""],
+    )
+    parser.add_argument(
+        "-if",
+        "--idle_futex",
+        nargs="+",
+        type=str,
+        help="List of futex timeouts in us for parking idle threads (empty to spin)",
+        default=[""],
+    )
+    parser.add_argument(
+        "-tg",
+        "--termination_group_sizes",
+        nargs="+",
+        type=str,
+        help="List of thread group sizes for hierarchical termination detection (empty for a flat counter)",
+        default=[""],
+    )
     parser.add_argument(
         "-d",
         "--debug",
@@ -199,6 +253,40 @@ def parse_args():
         help="Debug mode",
         default=["no"],
     )
+    parser.add_argument(
+        "-c",
+        "--compressed",
+        choices=["yes", "no", "both"],
+        type=str,
+        help="Run on compressed adjacency lists (graphs are compressed at load unless given as .csg)",
+        default=["no"],
+    )
+    parser.add_argument(
+        "-R",
+        "--relabel",
+        nargs="+",
+        choices=["none", "degree", "dbg", "bfs", "rcm", "gorder"],
+        type=str,
+        help="List of vertex relabeling strategies applied when loading the graph",
+        default=["none"],
+    )
+    parser.add_argument(
+        "-H",
+        "--page_policies",
+        nargs="+",
+        choices=["malloc", "thp", "hugetlb"],
+        type=str,
+        help="List of page policies for the large arrays (hugetlb needs a reserved hugetlbfs pool)",
+        default=["malloc"],
+    )
+    parser.add_argument(
+        "-N",
+        "--numa_policies",
+        nargs="+",
+        type=str,
+        help="List of NUMA placements for the large arrays (local, interleave[:nodes], bind:nodes)",
+        default=["local"],
+    )
     parser.add_argument(
         "-p",
         "--pin_threads",
@@ -207,6 +295,13 @@ def parse_args():
         help="Pin threads to cores / sockets according to machine. ht for hyperthreading",
         default="",
     )
+    parser.add_argument(
+        "-C",
+        "--cache_dir",
+        type=str,
+        help="Cache synthetic graphs (-g/-u) in this dir, so only the first run generates them",
+        default="",
+    )
     parser.add_argument("-o", "--output", type=str, help="Output dir", required=True)
     parsed_args = parser.parse_args()
 
@@ -217,6 +312,13 @@ def parse_args():
     else:
         parsed_args.debug = ["FALSE"]
 
+    if "both" in parsed_args.compressed:
+        parsed_args.compressed = ["FALSE", "TRUE"]
+    elif "yes" in parsed_args.compressed:
+        parsed_args.compressed = ["TRUE"]
+    else:
+        parsed_args.compressed = ["FALSE"]
+
     return Args(
         bfsargs=parsed_args.bfsargs,
         threads=parsed_args.threads,
@@ -224,9 +326,17 @@ def parse_args():
         n_samples=parsed_args.n_samples,
         n_subqueues=parsed_args.n_subqueues,
         batch_sizes=parsed_args.batch_sizes,
+        leaf_degrees=parsed_args.leaf_degrees,
+        idle_futex=parsed_args.idle_futex,
+        termination_group_sizes=parsed_args.termination_group_sizes,
         debug=parsed_args.debug,
+        compressed=parsed_args.compressed,
+        relabel=parsed_args.relabel,
+        page_policies=parsed_args.page_policies,
+        numa_policies=parsed_args.numa_policies,
         algorithms=parsed_args.algorithms,
         pin_threads=parsed_args.pin_threads,
+        cache_dir=parsed_args.cache_dir,
     )
 
 
@@ -312,19 +422,29 @@ def run_algorithms(algorithms: list[Algorithm], args: Args):
     already_run = set()
 
     os.makedirs(args.output_dir, exist_ok=True)
-    for algorithm, n_samples, n_subqueue, batch_size, debug in product(
+    if args.cache_dir:
+        os.makedirs(args.cache_dir, exist_ok=True)
+    for algorithm, n_samples, n_subqueue, batch_size, leaf_degree, idle_futex, termination_group_size, debug, compressed in product(
         algorithms,
         args.n_samples,
         args.n_subqueues,
         args.batch_sizes,
+        args.leaf_degrees,
+        args.idle_futex,
+        args.termination_group_sizes,
         args.debug,
+        args.compressed,
     ):
         make_command = algorithm.make_function(
             algorithm.name,
             N_SAMPLES=str(n_samples),
             N_SUBQUEUES=str(n_subqueue),
             BATCH_SIZE=str(batch_size),
+            LEAF_DEGREE=leaf_degree,
+            IDLE_FUTEX=idle_futex,
+            TERMINATION_GROUP_SIZE=termination_group_size,
             DEBUG=str(debug),
+            COMPRESSED=str(compressed),
         )
         output_name = algorithm.display_name
         if "N_SAMPLES" in algorithm.compilation_flags:
@@ -333,8 +453,16 @@ def run_algorithms(algorithms: list[Algorithm], args: Args):
             output_name += f"_SQ{n_subqueue}"
         if "BATCH_SIZE" in algorithm.compilation_flags:
             output_name += f"_BS{batch_size}"
+        if "LEAF_DEGREE" in algorithm.compilation_flags and leaf_degree:
+            output_name += f"_LD{leaf_degree}"
+        if "IDLE_FUTEX" in algorithm.compilation_flags and idle_futex:
+            output_name += f"_IF{idle_futex}"
+        if "TERMINATION_GROUP_SIZE" in algorithm.compilation_flags and termination_group_size:
+            output_name += f"_TG{termination_group_size}"
         if "DEBUG" in algorithm.compilation_flags and debug == "TRUE":
             output_name += f"_debug"
+        if "COMPRESSED" in algorithm.compilation_flags and compressed == "TRUE":
+            output_name += f"_compressed"
 
         # Skip if already run, happens when algs like DO don't care about different parameters, e.g., batch size
         if output_name in already_run:
@@ -347,9 +475,22 @@ def run_algorithms(algorithms: list[Algorithm], args: Args):
         proc = subprocess.run(make_command, shell=True, capture_output=True)
         check_return_code(proc, make_command)
 
-        for threads in args.threads:
+        for threads, relabel, page_policy, numa_policy in product(
+            args.threads, args.relabel, args.page_policies, args.numa_policies
+        ):
             thread_name = f"{threads}_ht" if "ht" in args.pin_threads else threads
-            run_command = f"{get_thread_command(args, threads)} ./bin/{algorithm.executable} {args.bfsargs} -o {output_name}_{thread_name}"
+            run_name = f"{output_name}_{thread_name}"
+            extra_args = f" -C {args.cache_dir}" if args.cache_dir else ""
+            if relabel != "none":
+                run_name += f"_R{relabel}"
+                extra_args += f" -R {relabel}"
+            if page_policy != "malloc":
+                run_name += f"_H{page_policy}"
+                extra_args += f" -H {page_policy}"
+            if numa_policy != "local":
+                run_name += f"_N{numa_policy.replace(':', '').replace(',', '_')}"
+                extra_args += f" -N {numa_policy}"
+            run_command = f"{get_thread_command(args, threads)} ./bin/{algorithm.executable} {args.bfsargs}{extra_args} -o {run_name}"
             print_aligned("Running", run_command)
             proc = subprocess.run(run_command, shell=True, capture_output=True)
             check_return_code(proc, run_command)
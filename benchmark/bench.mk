@@ -16,6 +16,10 @@ ALL_GRAPHS =\
 	$(addsuffix U.sg, $(GRAPHS))
 ALL_GRAPHS_WITH_PATHS = $(addprefix $(GRAPH_DIR)/, $(ALL_GRAPHS))
 
+# Memory budget (MB) for building from edge lists out of core, e.g., 16384
+CONVERT_BUDGET =
+CONVERT_ARGS = $(if $(CONVERT_BUDGET),-X $(CONVERT_BUDGET))
+
 $(RAW_GRAPH_DIR):
 	mkdir -p $@
 
@@ -38,13 +42,13 @@ $(RAW_GRAPH_DIR)/twitter.el: $(RAW_GRAPH_DIR)/twitter_rv.net
 	ln -s twitter_rv.net $@
 
 $(GRAPH_DIR)/twitter.sg: $(RAW_GRAPH_DIR)/twitter.el converter
-	./converter -f $< -b $@
+	./converter $(CONVERT_ARGS) -f $< -b $@
 
 $(GRAPH_DIR)/twitter.wsg: $(RAW_GRAPH_DIR)/twitter.el converter
-	./converter -f $< -wb $@
+	./converter $(CONVERT_ARGS) -f $< -wb $@
 
 $(GRAPH_DIR)/twitterU.sg: $(RAW_GRAPH_DIR)/twitter.el converter
-	./converter -sf $< -b $@
+	./converter $(CONVERT_ARGS) -sf $< -b $@
 
 ROAD_URL = http://www.dis.uniroma1.it/challenge9/data/USA-road-d/USA-road-d.USA.gr.gz
 $(RAW_GRAPH_DIR)/USA-road-d.USA.gr.gz:
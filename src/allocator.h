@@ -0,0 +1,405 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef ALLOCATOR_H_
+#define ALLOCATOR_H_
+
+#include <linux/mempolicy.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+/*
+GAP Benchmark Suite
+Class:  PageAllocator
+
+Allocates the large arrays (pvector and CSR storage) under a page policy
+selected at runtime (-H)
+ - malloc   plain heap allocation with the system page size
+ - thp      2MB-aligned allocation advised with MADV_HUGEPAGE, so random
+            accesses (e.g., to a parent array) walk far fewer TLB entries
+ - hugetlb  explicit huge pages from the hugetlbfs pool (MAP_HUGETLB), falls
+            back to thp if the pool can't satisfy the request
+ - Arrays smaller than one huge page always come from the heap
+ - Large arrays can also be placed on NUMA nodes with mbind (-N), otherwise
+   their pages land on the node of the thread that touches them first
+ - Elements are default-initialized like with new T_[n], in parallel with a
+   static schedule if that runs a constructor, so pages are first touched by
+   the threads that later work on them
+*/
+
+
+enum class PagePolicy {
+  MALLOC,
+  THP,
+  HUGETLB
+};
+
+std::string PagePolicyToString(PagePolicy pp) {
+  switch (pp) {
+    case PagePolicy::MALLOC:  return "malloc";
+    case PagePolicy::THP:     return "thp";
+    case PagePolicy::HUGETLB: return "hugetlb";
+    default:                  return "unknown";
+  }
+}
+
+
+class PageAllocator {
+ public:
+  static const size_t kHugePageSize = 1 << 21;
+
+  static PagePolicy policy() { return policy_; }
+  static void set_policy(PagePolicy policy) { policy_ = policy; }
+
+  /*
+  NUMA placement of large arrays, given as
+   - local              first touch (default)
+   - interleave[:nodes] round-robin pages over nodes (default all online)
+   - bind:nodes         restrict pages to nodes
+  where nodes is a list like 0-1,3
+  */
+  static std::string numa_policy() { return numa_name_; }
+
+  static void set_numa_policy(std::string name) {
+    std::string mode = name.substr(0, name.find(':'));
+    std::string nodes = name.find(':') == std::string::npos ? "" :
+                        name.substr(name.find(':') + 1);
+    numa_mask_.clear();
+    if (mode == "local") {
+      numa_mode_ = MPOL_DEFAULT;
+    } else if (mode == "interleave") {
+      numa_mode_ = MPOL_INTERLEAVE;
+      if (nodes == "")
+        nodes = OnlineNodes();
+    } else if ((mode == "bind") && (nodes != "")) {
+      numa_mode_ = MPOL_BIND;
+    } else {
+      std::cout << "Unknown NUMA policy: " << name << std::endl;
+      std::exit(-12);
+    }
+    if (numa_mode_ != MPOL_DEFAULT)
+      ParseNodes(nodes, name);
+    numa_name_ = name;
+  }
+
+  // Bytes currently allocated with the thp or hugetlb path
+  static size_t huge_bytes() { return huge_bytes_; }
+
+  static void* Allocate(size_t num_bytes) {
+    void* ptr = AllocatePages(num_bytes);
+    if (num_bytes >= kHugePageSize)
+      Place(ptr, num_bytes);
+    return ptr;
+  }
+
+  static void Free(void* ptr) {
+    if (ptr == nullptr)
+      return;
+    if (policy_ != PagePolicy::MALLOC) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = hugetlb_sizes_.find(ptr);
+      if (it != hugetlb_sizes_.end()) {
+        munmap(ptr, it->second);
+        huge_bytes_ -= it->second;
+        hugetlb_sizes_.erase(it);
+        return;
+      }
+      it = thp_sizes_.find(ptr);
+      if (it != thp_sizes_.end()) {
+        huge_bytes_ -= it->second;
+        thp_sizes_.erase(it);
+      }
+    }
+    std::free(ptr);
+  }
+
+  // Size of the allocation backing ptr if it came from a huge page path
+  static size_t HugeSize(void* ptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = hugetlb_sizes_.find(ptr);
+    if (it != hugetlb_sizes_.end())
+      return it->second;
+    it = thp_sizes_.find(ptr);
+    return it != thp_sizes_.end() ? it->second : 0;
+  }
+
+  // Bytes of this process actually backed by huge pages (THP or hugetlbfs)
+  static size_t ResidentHugeBytes() {
+    std::ifstream smaps("/proc/self/smaps_rollup");
+    std::string key;
+    size_t total_kb = 0;
+    while (smaps >> key) {
+      size_t kb;
+      if ((key == "AnonHugePages:") || (key == "Private_Hugetlb:") ||
+          (key == "Shared_Hugetlb:")) {
+        if (smaps >> kb)
+          total_kb += kb;
+      }
+      smaps.ignore(256, '\n');
+    }
+    return total_kb << 10;
+  }
+
+ private:
+  static void* AllocatePages(size_t num_bytes) {
+    if ((policy_ == PagePolicy::MALLOC) || (num_bytes < kHugePageSize))
+      return Checked(std::malloc(num_bytes), num_bytes);
+    size_t rounded = RoundUp(num_bytes);
+    if (policy_ == PagePolicy::HUGETLB) {
+      void* ptr = mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (ptr != MAP_FAILED) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        hugetlb_sizes_[ptr] = rounded;
+        huge_bytes_ += rounded;
+        return ptr;
+      }
+      if (!warned_.exchange(true))
+        std::cout << "hugetlbfs pool exhausted, falling back to thp"
+                  << std::endl;
+    }
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, kHugePageSize, rounded) != 0)
+      ptr = nullptr;
+    Checked(ptr, rounded);
+    // Advice is best effort, THP may be disabled system-wide
+    madvise(ptr, rounded, MADV_HUGEPAGE);
+    huge_bytes_ += rounded;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      thp_sizes_[ptr] = rounded;
+    }
+    return ptr;
+  }
+
+  // Applies the NUMA policy to the whole pages within [ptr, ptr+num_bytes)
+  static void Place(void* ptr, size_t num_bytes) {
+    if (numa_mode_ == MPOL_DEFAULT)
+      return;
+    const uintptr_t kPage = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(ptr) + kPage - 1) &
+                      ~(kPage - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(ptr) + num_bytes) &
+                    ~(kPage - 1);
+    if (end <= begin)
+      return;
+    const unsigned long kBits = 8 * sizeof(unsigned long);
+    // maxnode counts one past the last node, pages touched before (e.g.,
+    // reused heap memory) are moved so the policy holds for all of them
+    long result = syscall(SYS_mbind, begin, end - begin, numa_mode_,
+                          numa_mask_.data(), numa_mask_.size() * kBits + 1,
+                          MPOL_MF_MOVE);
+    if ((result != 0) && !numa_warned_.exchange(true))
+      std::cout << "mbind failed, keeping first-touch placement" << std::endl;
+  }
+
+  static std::string OnlineNodes() {
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string nodes;
+    if (!(online >> nodes))
+      nodes = "0";
+    return nodes;
+  }
+
+  static void ParseNodes(std::string nodes, std::string name) {
+    const int kBits = 8 * sizeof(unsigned long);
+    std::stringstream node_stream(nodes);
+    std::string range;
+    while (std::getline(node_stream, range, ',')) {
+      size_t dash = range.find('-');
+      int first, last;
+      try {
+        first = std::stoi(range.substr(0, dash));
+        last = dash == std::string::npos ? first :
+               std::stoi(range.substr(dash + 1));
+      } catch (const std::exception &) {
+        first = last = -1;
+      }
+      if ((first < 0) || (last < first)) {
+        std::cout << "Unknown NUMA policy: " << name << std::endl;
+        std::exit(-12);
+      }
+      for (int node = first; node <= last; node++) {
+        if (static_cast<size_t>(node / kBits) >= numa_mask_.size())
+          numa_mask_.resize(node / kBits + 1, 0);
+        numa_mask_[node / kBits] |= 1UL << (node % kBits);
+      }
+    }
+  }
+
+  static size_t RoundUp(size_t num_bytes) {
+    return (num_bytes + kHugePageSize - 1) & ~(kHugePageSize - 1);
+  }
+
+  static void* Checked(void* ptr, size_t num_bytes) {
+    if (ptr == nullptr) {
+      std::cout << "Couldn't allocate " << num_bytes << " bytes" << std::endl;
+      std::exit(-35);
+    }
+    return ptr;
+  }
+
+  static inline PagePolicy policy_ = PagePolicy::MALLOC;
+  static inline std::atomic<size_t> huge_bytes_{0};
+  static inline std::atomic<bool> warned_{false};
+  static inline std::atomic<bool> numa_warned_{false};
+  static inline int numa_mode_ = MPOL_DEFAULT;
+  static inline std::vector<unsigned long> numa_mask_;
+  static inline std::string numa_name_ = "local";
+  static inline std::mutex mutex_;
+  static inline std::map<void*, size_t> hugetlb_sizes_;
+  static inline std::map<void*, size_t> thp_sizes_;
+};
+
+
+template <typename T_>
+T_* AllocateArray(size_t num_elements) {
+  T_* start = static_cast<T_*>(
+    PageAllocator::Allocate(std::max<size_t>(num_elements, 1) * sizeof(T_)));
+  if (!std::is_trivially_default_constructible<T_>::value) {
+    #pragma omp parallel for schedule(static)
+    for (size_t i=0; i < num_elements; i++)
+      new (start + i) T_;
+  }
+  return start;
+}
+
+template <typename T_>
+void FreeArray(T_* start) {
+  static_assert(std::is_trivially_destructible<T_>::value,
+                "arrays are released without running destructors");
+  PageAllocator::Free(const_cast<typename std::remove_const<T_>::type*>(start));
+}
+
+// Resizes to num_elements keeping the first num_valid elements
+//  - Uses realloc for heap arrays, otherwise copies into a new allocation
+//  - Huge page arrays shrink in place by releasing the pages past the end
+template <typename T_>
+T_* ReallocateArray(T_* start, size_t num_valid, size_t num_elements) {
+  size_t huge_size = PageAllocator::HugeSize(start);
+  size_t num_bytes = num_elements * sizeof(T_);
+  if (num_bytes <= huge_size) {
+    const size_t kPage = PageAllocator::kHugePageSize;
+    size_t keep = (num_bytes + kPage - 1) & ~(kPage - 1);
+    if (keep < huge_size)
+      madvise(reinterpret_cast<char*>(start) + keep, huge_size - keep,
+              MADV_DONTNEED);
+    return start;
+  }
+  if ((huge_size == 0) &&
+      ((PageAllocator::policy() == PagePolicy::MALLOC) ||
+       (num_bytes < PageAllocator::kHugePageSize))) {
+    void* resized = std::realloc(start, std::max<size_t>(num_elements, 1) *
+                                        sizeof(T_));
+    if (resized == nullptr) {
+      std::cout << "Call to realloc() failed" << std::endl;
+      std::exit(-33);
+    }
+    return static_cast<T_*>(resized);
+  }
+  T_* resized = AllocateArray<T_>(num_elements);
+  std::memcpy(resized, start, std::min(num_valid, num_elements) * sizeof(T_));
+  FreeArray(start);
+  return resized;
+}
+
+
+/*
+Counts data TLB load misses with perf_event_open
+ - One counter per thread of the OpenMP pool, opened from within that thread
+ - Only counts if the kernel and perf_event_paranoid permit it, available()
+   tells whether the counts mean anything
+*/
+class TLBMissCounter {
+ public:
+  TLBMissCounter() {
+    std::mutex fds_mutex;
+    bool failed = false;
+    #pragma omp parallel
+    {
+      int fd = Open();
+      std::lock_guard<std::mutex> lock(fds_mutex);
+      if (fd == -1)
+        failed = true;
+      else
+        fds_.push_back(fd);
+    }
+    if (failed)
+      Close();
+  }
+
+  TLBMissCounter(const TLBMissCounter&) = delete;
+  TLBMissCounter& operator=(const TLBMissCounter&) = delete;
+
+  ~TLBMissCounter() {
+    Close();
+  }
+
+  bool available() const { return !fds_.empty(); }
+
+  void Start() {
+    for (int fd : fds_) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  int64_t Stop() {
+    if (fds_.empty())
+      return -1;
+    int64_t total = 0;
+    for (int fd : fds_) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      int64_t count;
+      if (read(fd, &count, sizeof(count)) != sizeof(count))
+        return -1;
+      total += count;
+    }
+    return total;
+  }
+
+ private:
+  static int Open() {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  void Close() {
+    for (int fd : fds_)
+      close(fd);
+    fds_.clear();
+  }
+
+  std::vector<int> fds_;
+};
+
+#endif  // ALLOCATOR_H_
@@ -13,8 +13,10 @@
 #include <omp.h>
 
 #include "builder.h"
+#include "compressed_graph.h"
 #include "graph.h"
 #include "timer.h"
+#include "trial_stats.h"
 #include "util.h"
 #include "writer.h"
 #include "json.h"
@@ -32,15 +34,31 @@ Various helper functions to ease writing of kernels
 
 
 // Default type signatures for commonly used types
+//  - make NODEID=64 widens vertex IDs for graphs beyond 2^31 vertices
+#if NODEID_BITS == 64
+typedef int64_t NodeID;
+#else
 typedef int32_t NodeID;
+#endif
 typedef int32_t WeightT;
 typedef NodeWeight<NodeID, WeightT> WNode;
 
-typedef CSRGraph<NodeID> Graph;
 typedef CSRGraph<NodeID, WNode> WGraph;
+typedef BuilderBase<NodeID, WNode, WeightT> WeightedBuilder;
+
+#ifdef COMPRESSED_GRAPH
+// Kernels that only iterate over neighborhoods can run on compressed graphs
+typedef CompressedCSRGraph<NodeID> Graph;
 
+class Builder : public BuilderBase<NodeID, NodeID, WeightT> {
+ public:
+  using BuilderBase::BuilderBase;
+  Graph MakeGraph() { return MakeCompressedGraph(); }
+};
+#else
+typedef CSRGraph<NodeID> Graph;
 typedef BuilderBase<NodeID, NodeID, WeightT> Builder;
-typedef BuilderBase<NodeID, WNode, WeightT> WeightedBuilder;
+#endif
 
 typedef WriterBase<NodeID, NodeID> Writer;
 typedef WriterBase<NodeID, WNode> WeightedWriter;
@@ -92,6 +110,15 @@ std::vector<std::pair<ValT, KeyT>> TopK(
 }
 
 
+// Reports the page and NUMA policies and how much huge pages back
+void PrintPagePolicy() {
+  PrintLabel("Page Policy", PagePolicyToString(PageAllocator::policy()));
+  PrintLabel("NUMA Policy", PageAllocator::numa_policy());
+  printf("%-21s%zu MB\n", "Huge Page Backed:",
+         PageAllocator::ResidentHugeBytes() >> 20);
+}
+
+
 bool VerifyUnimplemented(...) {
   std::cout << "** verify unimplemented **" << std::endl;
   return false;
@@ -105,14 +132,20 @@ void BenchmarkKernel(const CLApp &cli, const GraphT_ &g,
                      GraphFunc kernel, AnalysisFunc stats,
                      VerifierFunc verify) {
   g.PrintStats();
+  PrintPagePolicy();
   printf("\n");
   double total_seconds = 0;
   Timer trial_timer;
+  TLBMissCounter tlb_counter;
   for (int iter=0; iter < cli.num_trials(); iter++) {
+    tlb_counter.Start();
     trial_timer.Start();
     auto result = kernel(g);
     trial_timer.Stop();
+    int64_t tlb_misses = tlb_counter.Stop();
     PrintTime("Trial Time", trial_timer.Seconds());
+    if (tlb_counter.available())
+      printf("%-21s%" PRId64 "\n", "dTLB Misses:", tlb_misses);
     total_seconds += trial_timer.Seconds();
     if (cli.do_analysis() && (iter == (cli.num_trials()-1)))
       stats(g, result);
@@ -128,37 +161,80 @@ void BenchmarkKernel(const CLApp &cli, const GraphT_ &g,
   PrintTime("Average Time", total_seconds / cli.num_trials());
 }
 
+// Calls (and times) kernel like BenchmarkKernel, but also:
+//  - runs -W warm-up trials first, which are left out of the statistics
+//  - with -c, keeps running trials after the first -n until the bootstrap CI
+//    of the median is narrow enough, or -x trials were measured
+//  - summarizes the measured times with order statistics and bootstrap CIs,
+//    since relaxed BFS times vary a lot from run to run
+//  - returns all of it as JSON if structured output is enabled (-o)
+// trial_seconds maps the time the kernel took to the trial time, so kernels
+// with untimed setup (like generating an update batch) can report only the
+// part they measure themselves
 template<typename GraphT_, typename GraphFunc, typename AnalysisFunc,
-         typename VerifierFunc>
+         typename VerifierFunc, typename TrialSecondsFunc>
 json BenchmarkKernelWithStructuredOutput(const CLBFSApp &cli, const GraphT_ &g,
                      GraphFunc kernel, AnalysisFunc stats,
-                     VerifierFunc verify) {
-  if (!cli.structured_output()) {
-    BenchmarkKernel(cli, g, kernel, stats, verify);
-    return json();
-  }
+                     VerifierFunc verify, TrialSecondsFunc trial_seconds) {
   g.PrintStats();
+  PrintPagePolicy();
+  printf("\n");
   json structured_output;
   structured_output["nodes"] = g.num_nodes();
   structured_output["edges"] = g.num_edges_directed();
   structured_output["degree"] = g.num_edges() / g.num_nodes();
   structured_output["threads"] = omp_get_max_threads();
   structured_output["name"] = cli.name();
-  json times = json::array();
+  structured_output["relabel"] = RelabelStrategyToString(cli.relabel());
+  structured_output["page_policy"] = PagePolicyToString(cli.page_policy());
+  structured_output["numa_policy"] = PageAllocator::numa_policy();
+  structured_output["huge_page_bytes"] = PageAllocator::ResidentHugeBytes();
+  std::vector<double> times;
+  json warmup_times = json::array();
   json run_details = json::array();
-  double total_seconds = 0;
+  int min_trials = cli.num_trials();
+  int max_trials = min_trials;
+  if (cli.adaptive_trials())
+    max_trials = std::max(cli.max_trials(), min_trials);
+  bool converged = false;
+  // -n 0 only builds the graph, so no warm-ups or trials are run either
+  bool done = min_trials == 0;
   Timer trial_timer;
-  for (int iter=0; iter < cli.num_trials(); iter++) {
+  TLBMissCounter tlb_counter;
+  for (int iter=0; !done; iter++) {
+    bool warmup = iter < cli.num_warmups();
     json run_detail;
+    run_detail["warmup"] = warmup;
+    tlb_counter.Start();
     trial_timer.Start();
     auto result = kernel(g);
     trial_timer.Stop();
-    PrintTime("Trial Time", trial_timer.Seconds());
-    times.push_back(trial_timer.Seconds());
-    run_detail["time"] = trial_timer.Seconds();
-    total_seconds += trial_timer.Seconds();
-    if (cli.do_analysis() && (iter == (cli.num_trials()-1)))
+    int64_t tlb_misses = tlb_counter.Stop();
+    double seconds = trial_seconds(trial_timer.Seconds());
+    PrintTime(warmup ? "Warm-up Time" : "Trial Time", seconds);
+    if (tlb_counter.available()) {
+      printf("%-21s%" PRId64 "\n", "dTLB Misses:", tlb_misses);
+      run_detail["dtlb_misses"] = tlb_misses;
+    }
+    run_detail["time"] = seconds;
+    if (warmup) {
+      warmup_times.push_back(seconds);
+    } else {
+      times.push_back(seconds);
+      int measured = times.size();
+      // a bootstrap of fewer than 3 times says nothing about the spread
+      if (cli.adaptive_trials() && (measured >= std::max(min_trials, 3))) {
+        double width = TrialStats(times).RelativeMedianCIWidth();
+        printf("%-21s%.3g%%\n", "Median CI Width:", 100 * width);
+        run_detail["median_ci_width"] = width;
+        converged = width <= cli.target_ci_width();
+      }
+      done = converged || (measured >= max_trials);
+    }
+    if (cli.do_analysis() && done)
       stats(g, result);
+    // warm-ups are verified too, so verifiers that pick their own sources
+    // stay in step with the kernel
     if (cli.do_verify()) {
       trial_timer.Start();
       bool pass = verify(std::ref(g), std::ref(result));
@@ -169,12 +245,73 @@ json BenchmarkKernelWithStructuredOutput(const CLBFSApp &cli, const GraphT_ &g,
       PrintTime("Verification Time", trial_timer.Seconds());
     }
     run_details.push_back(run_detail);
+    printf("\n");
+  }
+  // nothing to summarize without measured times
+  if (times.empty()) {
+    if (!cli.structured_output())
+      return json();
+    structured_output["times"] = times;
+    structured_output["warmup_times"] = warmup_times;
+    structured_output["run_details"] = run_details;
+    return structured_output;
+  }
+  TrialStats trial_stats(times);
+  std::pair<double, double> median_ci = trial_stats.MedianCI();
+  std::pair<double, double> mean_ci = trial_stats.MeanCI();
+  PrintTime("Average Time", trial_stats.Mean());
+  PrintTime("Median Time", trial_stats.Median());
+  PrintTime("P10 Time", trial_stats.Percentile(0.1));
+  PrintTime("P90 Time", trial_stats.Percentile(0.9));
+  PrintTime("P99 Time", trial_stats.Percentile(0.99));
+  PrintTime("Std Dev Time", trial_stats.StdDev());
+  printf("%-21s[%3.5lf, %3.5lf]\n", "Median 95% CI:",
+         median_ci.first, median_ci.second);
+  if (cli.adaptive_trials())
+    printf("%-21s%zu (%s)\n", "Measured Trials:", times.size(),
+           converged ? "converged" : "hit -x");
+  if (!cli.structured_output())
+    return json();
+  json statistics;
+  statistics["trials"] = times.size();
+  statistics["warmup_trials"] = warmup_times.size();
+  statistics["mean"] = trial_stats.Mean();
+  statistics["median"] = trial_stats.Median();
+  statistics["p10"] = trial_stats.Percentile(0.1);
+  statistics["p90"] = trial_stats.Percentile(0.9);
+  statistics["p99"] = trial_stats.Percentile(0.99);
+  statistics["stddev"] = trial_stats.StdDev();
+  statistics["min"] = trial_stats.Min();
+  statistics["max"] = trial_stats.Max();
+  statistics["median_ci"] = {median_ci.first, median_ci.second};
+  statistics["mean_ci"] = {mean_ci.first, mean_ci.second};
+  statistics["ci_level"] = TrialStats::kConfidence;
+  statistics["bootstrap_resamples"] = TrialStats::kNumResamples;
+  if (cli.adaptive_trials()) {
+    json adaptive;
+    adaptive["target_ci_width"] = cli.target_ci_width();
+    adaptive["min_trials"] = min_trials;
+    adaptive["max_trials"] = max_trials;
+    adaptive["converged"] = converged;
+    statistics["adaptive"] = adaptive;
   }
   structured_output["times"] = times;
+  structured_output["warmup_times"] = warmup_times;
   structured_output["run_details"] = run_details;
-  structured_output["average_time"] = total_seconds / cli.num_trials();
-  PrintTime("Average Time", total_seconds / cli.num_trials());
+  structured_output["average_time"] = trial_stats.Mean();
+  structured_output["statistics"] = statistics;
   return structured_output;
 }
 
+template<typename GraphT_, typename GraphFunc, typename AnalysisFunc,
+         typename VerifierFunc>
+json BenchmarkKernelWithStructuredOutput(const CLBFSApp &cli, const GraphT_ &g,
+                     GraphFunc kernel, AnalysisFunc stats,
+                     VerifierFunc verify) {
+  return BenchmarkKernelWithStructuredOutput(cli, g, kernel, stats, verify,
+                                             [](double seconds) {
+                                               return seconds;
+                                             });
+}
+
 #endif  // BENCHMARK_H_
@@ -0,0 +1,212 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef BFS_VERIFIER_H_
+#define BFS_VERIFIER_H_
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "benchmark.h"
+#include "platform_atomics.h"
+#include "pvector.h"
+#include "sliding_queue.h"
+#include "util.h"
+
+
+/*
+GAP Benchmark Suite
+Function: BFSVerifier
+
+Checks a BFS parent array from source, shared by bfs and the relaxed BFSs
+ - Without samples, computes reference depths with a parallel
+   level-synchronous BFS and then checks every vertex in parallel:
+   - parent[source] = source
+   - parent[v] = u  =>  depth[v] = depth[u] + 1 (except for source)
+   - parent[v] = u  => there is edge from u to v
+   - all vertices reachable from source have a parent
+ - With num_samples (-V), checks that many random vertices without a
+   reference BFS, using the depths the parent array itself implies (found by
+   following parents to the source):
+   - parent[v] = u  => there is edge from u to v and u's path reaches source
+   - no in-neighbor of v has a path shorter than depth[v] - 1
+   - v has no parent  =>  no in-neighbor of v has one
+   These hold for every vertex exactly when the array is a BFS tree. The
+   first sample is always source, so if more than a fraction e of the
+   vertices is wrong, all samples pass with probability at most
+   (1-e)^(num_samples-1), and the bound on e at 99% confidence is printed
+ - Parents outside [0, num_nodes) are failures, not followed
+ - Prints the first few failures
+*/
+
+
+namespace bfs_verifier {
+
+const int kMaxReported = 8;
+
+// Reports a failure unless enough were already reported
+inline void Fail(int64_t &num_reported, const std::string &message) {
+  if (fetch_and_add(num_reported, 1) < kMaxReported) {
+    #pragma omp critical
+    std::cout << message << std::endl;
+  }
+}
+
+template <class GraphT_>
+pvector<NodeID> ReferenceDepths(const GraphT_ &g, NodeID source) {
+  pvector<NodeID> depth(g.num_nodes(), -1);
+  depth[source] = 0;
+  SlidingQueue<NodeID> queue(g.num_nodes());
+  queue.push_back(source);
+  queue.slide_window();
+  while (!queue.empty()) {
+    #pragma omp parallel
+    {
+      QueueBuffer<NodeID> lqueue(queue);
+      #pragma omp for nowait
+      for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+        NodeID u = *q_iter;
+        for (NodeID v : g.out_neigh(u)) {
+          if ((depth[v] == -1) &&
+              compare_and_swap(depth[v], static_cast<NodeID>(-1), depth[u] + 1))
+            lqueue.push_back(v);
+        }
+      }
+      lqueue.flush();
+    }
+    queue.slide_window();
+  }
+  return depth;
+}
+
+// Steps from v to source along parents, -1 if it takes more than max_steps
+// (or there is no path, or a parent is out of range)
+inline int64_t PathLength(const pvector<NodeID> &parent, NodeID source,
+                          NodeID v, int64_t max_steps) {
+  int64_t steps = 0;
+  while (v != source) {
+    if ((parent[v] < 0) || (parent[v] >= static_cast<int64_t>(parent.size())) ||
+        (steps == max_steps))
+      return -1;
+    v = parent[v];
+    steps++;
+  }
+  return steps;
+}
+
+template <class GraphT_>
+bool CheckAll(const GraphT_ &g, NodeID source,
+              const pvector<NodeID> &parent) {
+  pvector<NodeID> depth = ReferenceDepths(g, source);
+  int64_t num_reported = 0;
+  #pragma omp parallel for schedule(dynamic, 1024)
+  for (NodeID u = 0; u < g.num_nodes(); u++) {
+    if ((depth[u] != -1) && (parent[u] != -1)) {
+      if (u == source) {
+        if (!((parent[u] == u) && (depth[u] == 0)))
+          Fail(num_reported, "Source wrong");
+        continue;
+      }
+      bool parent_found = false;
+      for (NodeID v : g.in_neigh(u)) {
+        if (v == parent[u]) {
+          if (depth[v] != depth[u] - 1)
+            Fail(num_reported, "Wrong depths for " + std::to_string(u) +
+                               " & " + std::to_string(v));
+          parent_found = true;
+          break;
+        }
+      }
+      if (!parent_found)
+        Fail(num_reported, "Couldn't find edge from " +
+                           std::to_string(parent[u]) + " to " +
+                           std::to_string(u));
+    } else if (depth[u] != parent[u]) {
+      Fail(num_reported, "Reachability mismatch");
+    }
+  }
+  return num_reported == 0;
+}
+
+template <class GraphT_>
+bool CheckSampled(const GraphT_ &g, NodeID source,
+                  const pvector<NodeID> &parent, int64_t num_samples) {
+  std::mt19937_64 rng(kRandSeed + source);
+  UniDist<NodeID, std::mt19937_64> udist(g.num_nodes() - 1, rng);
+  pvector<NodeID> samples(num_samples);
+  samples[0] = source;
+  for (int64_t i = 1; i < num_samples; i++)
+    samples[i] = udist();
+  int64_t num_reported = 0;
+  #pragma omp parallel for schedule(dynamic, 16)
+  for (int64_t i = 0; i < num_samples; i++) {
+    NodeID u = samples[i];
+    if (u == source) {
+      if (parent[u] != u)
+        Fail(num_reported, "Source wrong");
+      continue;
+    }
+    if (parent[u] < 0) {
+      for (NodeID v : g.in_neigh(u)) {
+        if (parent[v] >= 0) {
+          Fail(num_reported, "Reachability mismatch for " +
+                             std::to_string(u));
+          break;
+        }
+      }
+      continue;
+    }
+    if (parent[u] >= g.num_nodes()) {
+      Fail(num_reported, "Parent out of range for " + std::to_string(u));
+      continue;
+    }
+    int64_t depth = PathLength(parent, source, u, g.num_nodes());
+    if (depth == -1) {
+      Fail(num_reported, "No path to source from " + std::to_string(u));
+      continue;
+    }
+    bool parent_found = false;
+    bool shortcut_found = false;
+    for (NodeID v : g.in_neigh(u)) {
+      parent_found |= v == parent[u];
+      // only paths shorter than depth - 1 need to be followed to the end
+      if (!shortcut_found && (depth >= 2) && (parent[v] >= 0))
+        shortcut_found = PathLength(parent, source, v, depth - 2) != -1;
+    }
+    if (shortcut_found)
+      Fail(num_reported, "Shorter path to " + std::to_string(u));
+    if (!parent_found)
+      Fail(num_reported, "Couldn't find edge from " +
+                         std::to_string(parent[u]) + " to " +
+                         std::to_string(u));
+  }
+  // samples[0] is source, so only the others are random draws
+  int64_t num_draws = num_samples - 1;
+  if (num_draws > 0) {
+    double max_wrong = 1 - std::pow(0.01, 1.0 / num_draws);
+    printf("%-21s%" PRId64 " (< %.3g%% wrong at 99%% confidence)\n",
+           "Sampled Vertices:", num_samples, 100 * max_wrong);
+  } else {
+    printf("%-21s%" PRId64 " (source only)\n", "Sampled Vertices:",
+           num_samples);
+  }
+  return num_reported == 0;
+}
+
+}  // namespace bfs_verifier
+
+
+template <class GraphT_>
+bool BFSVerifier(const GraphT_ &g, NodeID source,
+                 const pvector<NodeID> &parent, int64_t num_samples = 0) {
+  if (num_samples > 0)
+    return bfs_verifier::CheckSampled(g, source, parent, num_samples);
+  return bfs_verifier::CheckAll(g, source, parent);
+}
+
+#endif  // BFS_VERIFIER_H_
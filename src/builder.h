@@ -4,21 +4,29 @@
 #ifndef BUILDER_H_
 #define BUILDER_H_
 
+#include <unistd.h>
+
 #include <algorithm>
 #include <cinttypes>
+#include <cstdio>
 #include <fstream>
 #include <functional>
+#include <queue>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "command_line.h"
+#include "compressed_graph.h"
 #include "generator.h"
 #include "graph.h"
+#include "mapped_file.h"
 #include "platform_atomics.h"
 #include "pvector.h"
 #include "reader.h"
 #include "timer.h"
 #include "util.h"
+#include "writer.h"
 
 
 /*
@@ -30,7 +38,18 @@ Given arguments from the command line (cli), returns a built graph
  - MakeGraph() will parse cli and obtain edgelist to call
    MakeGraphFromEL(edgelist) to perform the actual graph construction
  - edgelist can be from file (Reader) or synthetically generated (Generator)
+ - with in-place building (-m), uniform and Kronecker graphs skip the
+   edgelist and are built from regenerated edges (MakeGraphFromGenerator)
+ - with partitioned building (-P), edges are radix-partitioned by source
+   so the CSR is built without atomics (MakeCSRPartitioned)
+ - MakeEdgeList() returns that edgelist without building (e.g., to save it)
  - Common case: BuilderBase typedef'd (w/ params) to be Builder (benchmark.h)
+ - with a cache directory (-C), synthetic graphs are saved there as .sg/.wsg
+   once and mapped on later runs (MakeCachedGraph)
+ - with a shared graph (-G), the graph published by graphd is mapped
+   read-only, sharing its memory with every other attached process
+ - MakeCompressedGraph() returns a CompressedCSRGraph instead (unweighted)
+ - Relabel(g, strategy) reorders vertices for locality (CLI: -R strategy)
 */
 
 
@@ -44,6 +63,7 @@ class BuilderBase {
   bool symmetrize_;
   bool needs_weights_;
   bool in_place_ = false;
+  bool partitioned_ = false;
   int64_t num_nodes_ = -1;
 
  public:
@@ -51,13 +71,21 @@ class BuilderBase {
     symmetrize_ = cli_.symmetrize();
     needs_weights_ = !std::is_same<NodeID_, DestID_>::value;
     in_place_ = cli_.in_place();
-    if (in_place_ && needs_weights_) {
+    partitioned_ = cli_.partitioned();
+    if (in_place_ && needs_weights_ && !BuildsFromGenerator()) {
       std::cout << "In-place building (-m) does not support weighted graphs"
                 << std::endl;
       exit(-30);
     }
   }
 
+  // In-place building of uniform or Kronecker graphs skips the edgelist
+  bool BuildsFromGenerator() const {
+    return in_place_ && (cli_.filename() == "") && (cli_.scale() != -1) &&
+           ((cli_.graph_type() == GraphType::UNIFORM) ||
+            (cli_.graph_type() == GraphType::KRONECKER));
+  }
+
   DestID_ GetSource(EdgePair<NodeID_, NodeID_> e) {
     return e.u;
   }
@@ -136,42 +164,194 @@ class BuilderBase {
     return prefix;
   }
 
+  // Partitions [begin, end) by pred using the tasks of the enclosing team,
+  // returns the start of the elements not satisfying pred (unstable)
+  template <typename T_, typename PredT_>
+  static T_* ParallelPartition(T_* begin, T_* end, PredT_ pred) {
+    const int64_t kNumChunks = 256;
+    int64_t n = end - begin;
+    int64_t chunk_size = (n + kNumChunks - 1) / kNumChunks;
+    std::vector<int64_t> num_true(kNumChunks);
+    #pragma omp taskloop grainsize(1) shared(num_true)
+    for (int64_t c=0; c < kNumChunks; c++) {
+      T_* c_begin = begin + std::min(c * chunk_size, n);
+      T_* c_end = begin + std::min((c + 1) * chunk_size, n);
+      num_true[c] = std::partition(c_begin, c_end, pred) - c_begin;
+    }
+    int64_t split = 0;
+    for (int64_t c=0; c < kNumChunks; c++)
+      split += num_true[c];
+    // misplaced elements (false left of split, true right of it) form one
+    // interval per chunk on each side, with the same total on both sides
+    typedef std::pair<int64_t, int64_t> Interval;
+    std::vector<Interval> lefts, rights;
+    std::vector<int64_t> left_ranks(1, 0), right_ranks(1, 0);
+    for (int64_t c=0; c < kNumChunks; c++) {
+      int64_t c_begin = std::min(c * chunk_size, n);
+      int64_t c_mid = c_begin + num_true[c];
+      int64_t c_end = std::min((c + 1) * chunk_size, n);
+      if (c_mid < std::min(c_end, split)) {
+        lefts.push_back(Interval(c_mid, std::min(c_end, split)));
+        left_ranks.push_back(left_ranks.back() + lefts.back().second - c_mid);
+      }
+      if (std::max(c_begin, split) < c_mid) {
+        rights.push_back(Interval(std::max(c_begin, split), c_mid));
+        right_ranks.push_back(right_ranks.back() + c_mid -
+                              rights.back().first);
+      }
+    }
+    int64_t num_misplaced = left_ranks.back();
+    auto locate = [](const std::vector<Interval> &intervals,
+                     const std::vector<int64_t> &ranks, int64_t rank,
+                     size_t &index) {
+      index = std::upper_bound(ranks.begin(), ranks.end(), rank) -
+              ranks.begin() - 1;
+      return intervals[index].first + rank - ranks[index];
+    };
+    #pragma omp taskloop grainsize(1) \
+      shared(lefts, rights, left_ranks, right_ranks)
+    for (int64_t c=0; c < kNumChunks; c++) {
+      int64_t first = num_misplaced * c / kNumChunks;
+      int64_t last = num_misplaced * (c + 1) / kNumChunks;
+      if (first == last)
+        continue;
+      size_t l, r;
+      int64_t l_pos = locate(lefts, left_ranks, first, l);
+      int64_t r_pos = locate(rights, right_ranks, first, r);
+      for (int64_t rank=first; rank < last; rank++) {
+        std::swap(begin[l_pos++], begin[r_pos++]);
+        if ((l_pos == lefts[l].second) && (l + 1 < lefts.size()))
+          l_pos = lefts[++l].first;
+        if ((r_pos == rights[r].second) && (r + 1 < rights.size()))
+          r_pos = rights[++r].first;
+      }
+    }
+    return begin + split;
+  }
+
+  // Quicksort with a task per partition, partitions large ranges in parallel
+  template <typename T_>
+  static void ParallelSortTask(T_* begin, T_* end) {
+    const int64_t kSerialSize = 1 << 16;
+    const int64_t kParallelPartitionSize = 1 << 22;
+    while (end - begin > kSerialSize) {
+      T_ a = *begin, b = begin[(end - begin) / 2], c = *(end - 1);
+      T_ pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+      auto less = [&pivot](const T_ &x) { return x < pivot; };
+      auto not_greater = [&pivot](const T_ &x) { return !(pivot < x); };
+      T_ *lower, *upper;
+      if (end - begin > kParallelPartitionSize) {
+        lower = ParallelPartition(begin, end, less);
+        upper = ParallelPartition(lower, end, not_greater);
+      } else {
+        lower = std::partition(begin, end, less);
+        upper = std::partition(lower, end, not_greater);
+      }
+      #pragma omp task
+      ParallelSortTask(begin, lower);
+      begin = upper;
+    }
+    std::sort(begin, end);
+  }
+
+  // Sorts in place (no additional memory) with all threads
+  template <typename T_>
+  static void ParallelSort(T_* begin, T_* end) {
+    #pragma omp parallel
+    #pragma omp single
+    ParallelSortTask(begin, end);
+  }
+
+  // Sorts a neighborhood by LSD radix sort on neighbor IDs (bytes that are
+  // the same for all neighbors are skipped), small ones with std::sort
+  //  - buffer is scratch space, grown as needed
+  //  - weighted: runs of the same neighbor are then sorted by weight
+  static void RadixSortNeighs(DestID_* begin, DestID_* end,
+                              std::vector<DestID_> &buffer) {
+    typedef typename std::make_unsigned<NodeID_>::type uNodeID_;
+    const int64_t kRadixMinSize = 256;
+    int64_t n = end - begin;
+    if (n < kRadixMinSize) {
+      std::sort(begin, end);
+      return;
+    }
+    if (buffer.size() < static_cast<size_t>(n))
+      buffer.resize(n);
+    auto key = [](DestID_ d) {
+      return static_cast<uNodeID_>(static_cast<NodeID_>(d));
+    };
+    DestID_ *from = begin, *to = buffer.data();
+    for (size_t shift=0; shift < sizeof(NodeID_) * 8; shift += 8) {
+      int64_t counts[256] = {};
+      for (DestID_ *it = from; it < from + n; it++)
+        counts[(key(*it) >> shift) & 0xFF]++;
+      if (counts[(key(*from) >> shift) & 0xFF] == n)
+        continue;
+      int64_t total = 0;
+      for (int b=0; b < 256; b++) {
+        int64_t count = counts[b];
+        counts[b] = total;
+        total += count;
+      }
+      for (DestID_ *it = from; it < from + n; it++)
+        to[counts[(key(*it) >> shift) & 0xFF]++] = *it;
+      std::swap(from, to);
+    }
+    if (from != begin)
+      std::copy(from, from + n, begin);
+    if (!std::is_same<NodeID_, DestID_>::value) {
+      for (DestID_ *run = begin; run < end; ) {
+        DestID_ *run_end = run + 1;
+        while ((run_end < end) && (key(*run_end) == key(*run)))
+          run_end++;
+        if (run_end - run > 1)
+          std::sort(run, run_end);
+        run = run_end;
+      }
+    }
+  }
+
   // Removes self-loops and redundant edges
   // Side effect: neighbor IDs will be sorted
   void SquishCSR(const CSRGraph<NodeID_, DestID_, invert> &g, bool transpose,
-                 DestID_*** sq_index, DestID_** sq_neighs) {
+                 CSROffsets* sq_index, DestID_** sq_neighs) {
     pvector<NodeID_> diffs(g.num_nodes());
     DestID_ *n_start, *n_end;
-    #pragma omp parallel for private(n_start, n_end)
-    for (NodeID_ n=0; n < g.num_nodes(); n++) {
-      if (transpose) {
-        n_start = g.in_neigh(n).begin();
-        n_end = g.in_neigh(n).end();
-      } else {
-        n_start = g.out_neigh(n).begin();
-        n_end = g.out_neigh(n).end();
+    #pragma omp parallel private(n_start, n_end)
+    {
+      std::vector<DestID_> buffer;
+      #pragma omp for schedule(dynamic, 1024)
+      for (NodeID_ n=0; n < g.num_nodes(); n++) {
+        if (transpose) {
+          n_start = g.in_neigh(n).begin();
+          n_end = g.in_neigh(n).end();
+        } else {
+          n_start = g.out_neigh(n).begin();
+          n_end = g.out_neigh(n).end();
+        }
+        RadixSortNeighs(n_start, n_end, buffer);
+        DestID_ *new_end = std::unique(n_start, n_end);
+        new_end = std::remove(n_start, new_end, n);
+        diffs[n] = new_end - n_start;
       }
-      std::sort(n_start, n_end);
-      DestID_ *new_end = std::unique(n_start, n_end);
-      new_end = std::remove(n_start, new_end, n);
-      diffs[n] = new_end - n_start;
     }
     pvector<SGOffset> sq_offsets = ParallelPrefixSum(diffs);
-    *sq_neighs = new DestID_[sq_offsets[g.num_nodes()]];
-    *sq_index = CSRGraph<NodeID_, DestID_>::GenIndex(sq_offsets, *sq_neighs);
+    *sq_neighs = AllocateArray<DestID_>(sq_offsets[g.num_nodes()]);
     #pragma omp parallel for private(n_start)
     for (NodeID_ n=0; n < g.num_nodes(); n++) {
       if (transpose)
         n_start = g.in_neigh(n).begin();
       else
         n_start = g.out_neigh(n).begin();
-      std::copy(n_start, n_start+diffs[n], (*sq_index)[n]);
+      std::copy(n_start, n_start+diffs[n], *sq_neighs + sq_offsets[n]);
     }
+    *sq_index = CSROffsets::Adopt(std::move(sq_offsets));
   }
 
   CSRGraph<NodeID_, DestID_, invert> SquishGraph(
       const CSRGraph<NodeID_, DestID_, invert> &g) {
-    DestID_ **out_index, *out_neighs, **in_index, *in_neighs;
+    CSROffsets out_index, in_index;
+    DestID_ *out_neighs, *in_neighs;
     SquishCSR(g, false, &out_index, &out_neighs);
     if (g.directed()) {
       if (invert)
@@ -187,54 +367,103 @@ class BuilderBase {
 
   /*
   In-Place Graph Building Steps
-    - sort edges and squish (remove self loops and redundant edges)
-    - overwrite EdgeList's memory with outgoing neighbors
+    - sort edges in parallel
+    - count degrees without self loops and redundant edges
+    - overwrite EdgeList's memory with outgoing neighbors, squishing while
+      compacting blocks of edges in parallel
     - if graph not being symmetrized
       - finalize structures and make incoming structures if requested
     - if being symmetrized
       - search for needed inverses, make room for them, add them in place
   */
-  void MakeCSRInPlace(EdgeList &el, DestID_*** index, DestID_** neighs,
-                      DestID_*** inv_index, DestID_** inv_neighs) {
-    // preprocess EdgeList - sort & squish in place
-    std::sort(el.begin(), el.end());
-    auto new_end = std::unique(el.begin(), el.end());
-    el.resize(new_end - el.begin());
-    auto self_loop = [](Edge e){ return e.u == e.v; };
-    new_end = std::remove_if(el.begin(), el.end(), self_loop);
-    el.resize(new_end - el.begin());
-    // analyze EdgeList and repurpose it for outgoing edges
-    pvector<NodeID_> degrees = CountDegrees(el, false);
+  void MakeCSRInPlace(EdgeList &el, CSROffsets* index, DestID_** neighs,
+                      CSROffsets* inv_index, DestID_** inv_neighs) {
+    // preprocess EdgeList - sort in place, squish below while compacting
+    ParallelSort(el.begin(), el.end());
+    int64_t num_in_edges = el.size();
+    auto redundant = [&el](int64_t i) {
+      return (el[i].v == el[i].u) || ((i != 0) && (el[i] == el[i-1]));
+    };
+    // analyze EdgeList
+    pvector<NodeID_> degrees(num_nodes_, 0);
+    pvector<NodeID_> indegrees(symmetrize_ ? 0 : num_nodes_, 0);
+    #pragma omp parallel for
+    for (int64_t i=0; i < num_in_edges; i++) {
+      if (!redundant(i)) {
+        fetch_and_add(degrees[el[i].u], 1);
+        if (!symmetrize_)
+          fetch_and_add(indegrees[static_cast<NodeID_>(el[i].v)], 1);
+      }
+    }
     pvector<SGOffset> offsets = ParallelPrefixSum(degrees);
-    pvector<NodeID_> indegrees = CountDegrees(el, true);
+    degrees = pvector<NodeID_>();
+    size_t num_edges = offsets[num_nodes_];
+    // repurpose EdgeList for outgoing neighbors - blocks compact to their
+    //   own start in parallel (writes trail reads), then move down in order
+    const int64_t kBlockEdges = 1 << 20;
+    int64_t num_blocks = (num_in_edges + kBlockEdges - 1) / kBlockEdges;
+    pvector<bool> first_redundant(num_blocks);
+    for (int64_t b=0; b < num_blocks; b++)
+      first_redundant[b] = redundant(b * kBlockEdges);
+    pvector<SGOffset> kept(num_blocks);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t b=0; b < num_blocks; b++) {
+      int64_t block_end = std::min((b + 1) * kBlockEdges, num_in_edges);
+      DestID_ *block_start = reinterpret_cast<DestID_*>(&el[b * kBlockEdges]);
+      DestID_ *to = block_start;
+      Edge prev = el[b * kBlockEdges];
+      if (!first_redundant[b])
+        *to++ = prev.v;
+      for (int64_t i = b * kBlockEdges + 1; i < block_end; i++) {
+        Edge e = el[i];
+        if (!((e.v == e.u) || (e == prev)))
+          *to++ = e.v;
+        prev = e;
+      }
+      kept[b] = to - block_start;
+    }
     *neighs = reinterpret_cast<DestID_*>(el.data());
-    for (Edge e : el)
-      (*neighs)[offsets[e.u]++] = e.v;
-    size_t num_edges = el.size();
+    SGOffset num_moved = 0;
+    for (int64_t b=0; b < num_blocks; b++) {
+      DestID_ *from = reinterpret_cast<DestID_*>(&el[b * kBlockEdges]);
+      DestID_ *to = *neighs + num_moved;
+      if (to + kept[b] <= from)
+        ParallelCopy(to, from, kept[b] * sizeof(DestID_));
+      else
+        std::copy(from, from + kept[b], to);
+      num_moved += kept[b];
+    }
     el.leak();
-    // revert offsets by shifting them down
-    for (NodeID_ n = num_nodes_; n >= 0; n--)
-      offsets[n] = n != 0 ? offsets[n-1] : 0;
     if (!symmetrize_) {   // not going to symmetrize so no need to add edges
-      size_t new_size = num_edges * sizeof(DestID_);
-      *neighs = static_cast<DestID_*>(std::realloc(*neighs, new_size));
-      *index = CSRGraph<NodeID_, DestID_>::GenIndex(offsets, *neighs);
+      *neighs = ReallocateArray(*neighs, num_edges, num_edges);
       if (invert) {       // create inv_neighs & inv_index for incoming edges
         pvector<SGOffset> inoffsets = ParallelPrefixSum(indegrees);
-        *inv_neighs = new DestID_[inoffsets[num_nodes_]];
-        *inv_index = CSRGraph<NodeID_, DestID_>::GenIndex(inoffsets,
-                                                          *inv_neighs);
-        for (NodeID_ u = 0; u < num_nodes_; u++) {
-          for (DestID_* it = (*index)[u]; it < (*index)[u+1]; it++) {
-            NodeID_ v = static_cast<NodeID_>(*it);
-            (*inv_neighs)[inoffsets[v]] = u;
-            inoffsets[v]++;
+        *inv_neighs = AllocateArray<DestID_>(inoffsets[num_nodes_]);
+        {
+          pvector<SGOffset> in_tails(inoffsets.begin(), inoffsets.end());
+          #pragma omp parallel for schedule(dynamic, 1024)
+          for (NodeID_ u = 0; u < num_nodes_; u++) {
+            for (SGOffset i = offsets[u]; i < offsets[u+1]; i++) {
+              NodeID_ v = static_cast<NodeID_>((*neighs)[i]);
+              (*inv_neighs)[fetch_and_add(in_tails[v], 1)] = u;
+            }
           }
         }
+        // threads fill in ascending source order, so most are still sorted
+        #pragma omp parallel for schedule(dynamic, 1024)
+        for (NodeID_ n = 0; n < num_nodes_; n++) {
+          DestID_ *n_start = *inv_neighs + inoffsets[n];
+          DestID_ *n_end = *inv_neighs + inoffsets[n+1];
+          if (!std::is_sorted(n_start, n_end))
+            std::sort(n_start, n_end);
+        }
+        *inv_index = CSROffsets::Adopt(std::move(inoffsets));
       }
+      *index = CSROffsets::Adopt(std::move(offsets));
     } else {              // symmetrize graph by adding missing inverse edges
       // Step 1 - count number of needed inverses
       pvector<NodeID_> invs_needed(num_nodes_, 0);
+      #pragma omp parallel for schedule(dynamic, 1024)
       for (NodeID_ u = 0; u < num_nodes_; u++) {
         for (SGOffset i = offsets[u]; i < offsets[u+1]; i++) {
           DestID_ v = (*neighs)[i];
@@ -242,51 +471,61 @@ class BuilderBase {
                                               *neighs + offsets[v+1],
                                               static_cast<DestID_>(u));
           if (!inv_found)
-            invs_needed[v]++;
+            fetch_and_add(invs_needed[v], 1);
         }
       }
       // increase offsets to account for missing inverses, realloc neighs
-      SGOffset total_missing_inv = 0;
-      for (NodeID_ n = 0; n < num_nodes_; n++) {
-        offsets[n] += total_missing_inv;
-        total_missing_inv += invs_needed[n];
-      }
-      offsets[num_nodes_] += total_missing_inv;
-      size_t newsize = (offsets[num_nodes_] * sizeof(DestID_));
-      *neighs = static_cast<DestID_*>(std::realloc(*neighs, newsize));
-      if (*neighs == nullptr) {
-        std::cout << "Call to realloc() failed" << std::endl;
-        exit(-33);
-      }
+      pvector<SGOffset> invs_before = ParallelPrefixSum(invs_needed);
+      #pragma omp parallel for
+      for (NodeID_ n = 0; n <= num_nodes_; n++)
+        offsets[n] += invs_before[n];
+      *neighs = ReallocateArray(*neighs, num_edges, offsets[num_nodes_]);
+      auto old_offset = [&](int64_t n) { return offsets[n] - invs_before[n]; };
       // Step 2 - spread out existing neighs to make room for inverses
-      //   copies backwards (overwrites) and inserts free space at starts
-      SGOffset tail_index = offsets[num_nodes_] - 1;
-      for (NodeID_ n = num_nodes_ - 1; n >= 0; n--) {
-        SGOffset new_start = offsets[n] + invs_needed[n];
-        for (SGOffset i = offsets[n+1]-1; i >= new_start; i--) {
-          (*neighs)[tail_index] = (*neighs)[i - total_missing_inv];
-          tail_index--;
+      //   moves blocks of vertices up by the shift of their first vertex in
+      //   reverse order, then spreads within blocks in parallel (inserting
+      //   free space at starts)
+      const int64_t kBlockNodes = 1 << 14;
+      int64_t last_block = ((num_nodes_ - 1) / kBlockNodes) * kBlockNodes;
+      for (int64_t block = last_block; block >= 0; block -= kBlockNodes) {
+        int64_t block_end = std::min(block + kBlockNodes, num_nodes_);
+        SGOffset shift = invs_before[block];
+        DestID_ *from = *neighs + old_offset(block);
+        DestID_ *from_end = *neighs + old_offset(block_end);
+        if (from + shift >= from_end)
+          ParallelCopy(from + shift, from, (from_end - from) * sizeof(DestID_));
+        else
+          std::copy_backward(from, from_end, from_end + shift);
+      }
+      #pragma omp parallel for schedule(dynamic, 1)
+      for (int64_t block = 0; block < num_nodes_; block += kBlockNodes) {
+        int64_t block_end = std::min(block + kBlockNodes, num_nodes_);
+        for (int64_t n = block_end - 1; n >= block; n--) {
+          DestID_ *from = *neighs + old_offset(n) + invs_before[block];
+          DestID_ *from_end = *neighs + old_offset(n+1) + invs_before[block];
+          std::copy_backward(from, from_end, *neighs + offsets[n+1]);
         }
-        total_missing_inv -= invs_needed[n];
-        tail_index -= invs_needed[n];
       }
       // Step 3 - add missing inverse edges into free spaces from Step 2
+      #pragma omp parallel for schedule(dynamic, 1024)
       for (NodeID_ u = 0; u < num_nodes_; u++) {
-        for (SGOffset i = offsets[u] + invs_needed[u]; i < offsets[u+1]; i++) {
-          DestID_ v = (*neighs)[i];
-          bool inv_found = std::binary_search(
-                             *neighs + offsets[v] + invs_needed[v],
-                             *neighs + offsets[v+1],
-                             static_cast<DestID_>(u));
+        SGOffset u_start = offsets[u] + invs_before[u+1] - invs_before[u];
+        for (SGOffset i = u_start; i < offsets[u+1]; i++) {
+          NodeID_ v = static_cast<NodeID_>((*neighs)[i]);
+          SGOffset v_start = offsets[v] + invs_before[v+1] - invs_before[v];
+          bool inv_found = std::binary_search(*neighs + v_start,
+                                              *neighs + offsets[v+1],
+                                              static_cast<DestID_>(u));
           if (!inv_found) {
-            (*neighs)[offsets[v] + invs_needed[v] -1] = static_cast<DestID_>(u);
-            invs_needed[v]--;
+            SGOffset slot = offsets[v] + fetch_and_add(invs_needed[v], -1) - 1;
+            (*neighs)[slot] = static_cast<DestID_>(u);
           }
         }
       }
+      #pragma omp parallel for schedule(dynamic, 1024)
       for (NodeID_ n = 0; n < num_nodes_; n++)
         std::sort(*neighs + offsets[n], *neighs + offsets[n+1]);
-      *index = CSRGraph<NodeID_, DestID_>::GenIndex(offsets, *neighs);
+      *index = CSROffsets::Adopt(std::move(offsets));
     }
   }
 
@@ -294,15 +533,15 @@ class BuilderBase {
   Graph Building Steps (for CSR):
     - Read edgelist once to determine vertex degrees (CountDegrees)
     - Determine vertex offsets by a prefix sum (ParallelPrefixSum)
-    - Allocate storage and set points according to offsets (GenIndex)
+    - Allocate storage and keep a copy of offsets as index (CSROffsets)
     - Copy edges into storage
   */
-  void MakeCSR(const EdgeList &el, bool transpose, DestID_*** index,
+  void MakeCSR(const EdgeList &el, bool transpose, CSROffsets* index,
                DestID_** neighs) {
     pvector<NodeID_> degrees = CountDegrees(el, transpose);
     pvector<SGOffset> offsets = ParallelPrefixSum(degrees);
-    *neighs = new DestID_[offsets[num_nodes_]];
-    *index = CSRGraph<NodeID_, DestID_>::GenIndex(offsets, *neighs);
+    *neighs = AllocateArray<DestID_>(offsets[num_nodes_]);
+    *index = CSROffsets::Copy(offsets);
     #pragma omp parallel for
     for (auto it = el.begin(); it < el.end(); it++) {
       Edge e = *it;
@@ -314,8 +553,213 @@ class BuilderBase {
     }
   }
 
+  // Squishes a CSR in place (like SquishCSR) given the offsets it was built
+  // with, compacting neighs into the squished offsets set as index
+  void SquishCSRInPlace(const pvector<SGOffset> &offsets, DestID_** neighs,
+                        CSROffsets* index) {
+    pvector<NodeID_> diffs(num_nodes_);
+    #pragma omp parallel
+    {
+      std::vector<DestID_> buffer;
+      #pragma omp for schedule(dynamic, 1024)
+      for (NodeID_ n=0; n < num_nodes_; n++) {
+        DestID_ *n_start = *neighs + offsets[n];
+        DestID_ *n_end = *neighs + offsets[n+1];
+        RadixSortNeighs(n_start, n_end, buffer);
+        DestID_ *new_end = std::unique(n_start, n_end);
+        new_end = std::remove(n_start, new_end, n);
+        diffs[n] = new_end - n_start;
+      }
+    }
+    pvector<SGOffset> sq_offsets = ParallelPrefixSum(diffs);
+    // Compacts within blocks of vertices in parallel, then moves the blocks
+    // down in order (targets never pass their sources)
+    const int64_t kBlockNodes = 1 << 16;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t block=0; block < num_nodes_; block+=kBlockNodes) {
+      int64_t block_end = std::min(block + kBlockNodes, num_nodes_);
+      DestID_ *to = *neighs + offsets[block];
+      for (int64_t n=block; n < block_end; n++) {
+        std::copy(*neighs + offsets[n], *neighs + offsets[n] + diffs[n], to);
+        to += diffs[n];
+      }
+    }
+    for (int64_t block=0; block < num_nodes_; block+=kBlockNodes) {
+      int64_t block_end = std::min(block + kBlockNodes, num_nodes_);
+      std::copy(*neighs + offsets[block],
+                *neighs + offsets[block] +
+                  (sq_offsets[block_end] - sq_offsets[block]),
+                *neighs + sq_offsets[block]);
+    }
+    *neighs = ReallocateArray(*neighs, sq_offsets[num_nodes_],
+                              sq_offsets[num_nodes_]);
+    *index = CSROffsets::Adopt(std::move(sq_offsets));
+  }
+
+  /*
+  Direct Graph Building Steps (uniform and Kronecker generators):
+    - Regenerate edges to determine vertex degrees (no edge list)
+    - Determine vertex offsets by a prefix sum and allocate storage
+    - Regenerate edges again to copy them into storage
+    - Squish in place, so peak memory is about the size of the graph
+  Builds the same graph as the edgelist would, but generates edges twice
+  */
+  CSRGraph<NodeID_, DestID_, invert> MakeGraphFromGenerator() {
+    Generator<NodeID_, DestID_, WeightT_> gen(cli_.scale(), cli_.degree());
+    bool uniform = cli_.graph_type() == GraphType::UNIFORM;
+    bool transpose = !symmetrize_ && invert;
+    Timer t;
+    t.Start();
+    pvector<NodeID_> degrees(gen.num_nodes(), 0);
+    pvector<NodeID_> in_degrees(symmetrize_ ? 0 : gen.num_nodes(), 0);
+    gen.VisitEdges(uniform, needs_weights_, [&](int64_t, Edge e) {
+      fetch_and_add(degrees[e.u], 1);
+      if (symmetrize_)
+        fetch_and_add(degrees[static_cast<NodeID_>(e.v)], 1);
+      else
+        fetch_and_add(in_degrees[static_cast<NodeID_>(e.v)], 1);
+    });
+    NodeID_ max_seen = 0;
+    #pragma omp parallel for reduction(max : max_seen)
+    for (NodeID_ n=0; n < gen.num_nodes(); n++) {
+      if ((degrees[n] != 0) || (!symmetrize_ && (in_degrees[n] != 0)))
+        max_seen = n;
+    }
+    num_nodes_ = max_seen + 1;
+    degrees.resize(num_nodes_);
+    pvector<SGOffset> offsets = ParallelPrefixSum(degrees);
+    degrees = pvector<NodeID_>();
+    DestID_ *neighs = AllocateArray<DestID_>(offsets[num_nodes_]);
+    pvector<SGOffset> in_offsets;
+    DestID_ *in_neighs = nullptr;
+    if (transpose) {
+      in_degrees.resize(num_nodes_);
+      in_offsets = ParallelPrefixSum(in_degrees);
+      in_neighs = AllocateArray<DestID_>(in_offsets[num_nodes_]);
+    }
+    in_degrees = pvector<NodeID_>();
+    {
+      pvector<SGOffset> tails(offsets.begin(), offsets.end());
+      pvector<SGOffset> in_tails(in_offsets.begin(), in_offsets.end());
+      gen.VisitEdges(uniform, needs_weights_, [&](int64_t, Edge e) {
+        neighs[fetch_and_add(tails[e.u], 1)] = e.v;
+        if (symmetrize_)
+          neighs[fetch_and_add(tails[static_cast<NodeID_>(e.v)], 1)] =
+              GetSource(e);
+        else if (transpose)
+          in_neighs[fetch_and_add(in_tails[static_cast<NodeID_>(e.v)], 1)] =
+              GetSource(e);
+      });
+    }
+    CSROffsets index, in_index;
+    SquishCSRInPlace(offsets, &neighs, &index);
+    if (transpose)
+      SquishCSRInPlace(in_offsets, &in_neighs, &in_index);
+    t.Stop();
+    PrintLabel("Graph Type", GraphTypeToString(cli_.graph_type()));
+    PrintTime("Build Time", t.Seconds());
+    if (symmetrize_)
+      return CSRGraph<NodeID_, DestID_, invert>(num_nodes_, index, neighs);
+    else
+      return CSRGraph<NodeID_, DestID_, invert>(num_nodes_, index, neighs,
+                                                in_index, in_neighs);
+  }
+
+  /*
+  Partitioned Graph Building Steps (for CSR, -P):
+    - Count edges per chunk of the edgelist and range of vertices (bucket)
+    - Scatter edges (as vertex, neighbor) into buckets, every chunk into
+      its own part of each bucket, so no atomics are needed (radix pass)
+    - Build each bucket's slice of the CSR (degrees, offsets, neighbors)
+      within the bucket, which starts where the bucket's neighbors do
+  Uses a buffer of all edges, so takes more memory than MakeCSR
+  */
+  void MakeCSRPartitioned(const EdgeList &el, bool transpose,
+                          CSROffsets* index, DestID_** neighs) {
+    const int64_t kNumChunks = 256;
+    const int64_t kMaxBuckets = 1 << 12;
+    bool forward = symmetrize_ || !transpose;
+    bool backward = symmetrize_ || transpose;
+    int shift = 0;
+    while ((num_nodes_ >> shift) > kMaxBuckets)
+      shift++;
+    int64_t num_buckets = ((num_nodes_ - 1) >> shift) + 1;
+    int64_t num_el = el.size();
+    int64_t chunk_size = (num_el + kNumChunks - 1) / kNumChunks;
+    Timer t;
+    t.Start();
+    pvector<SGOffset> cursors(kNumChunks * num_buckets, 0);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t c=0; c < kNumChunks; c++) {
+      SGOffset *counts = &cursors[c * num_buckets];
+      int64_t chunk_end = std::min((c + 1) * chunk_size, num_el);
+      for (int64_t i = c * chunk_size; i < chunk_end; i++) {
+        Edge e = el[i];
+        if (forward)
+          counts[e.u >> shift]++;
+        if (backward)
+          counts[static_cast<NodeID_>(e.v) >> shift]++;
+      }
+    }
+    pvector<SGOffset> bucket_starts(num_buckets + 1);
+    SGOffset total = 0;
+    for (int64_t b=0; b < num_buckets; b++) {
+      bucket_starts[b] = total;
+      for (int64_t c=0; c < kNumChunks; c++) {
+        SGOffset count = cursors[c * num_buckets + b];
+        cursors[c * num_buckets + b] = total;
+        total += count;
+      }
+    }
+    bucket_starts[num_buckets] = total;
+    EdgeList records(total);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t c=0; c < kNumChunks; c++) {
+      SGOffset *chunk_cursors = &cursors[c * num_buckets];
+      int64_t chunk_end = std::min((c + 1) * chunk_size, num_el);
+      for (int64_t i = c * chunk_size; i < chunk_end; i++) {
+        Edge e = el[i];
+        if (forward)
+          records[chunk_cursors[e.u >> shift]++] = e;
+        if (backward) {
+          NodeID_ v = static_cast<NodeID_>(e.v);
+          records[chunk_cursors[v >> shift]++] = Edge(v, GetSource(e));
+        }
+      }
+    }
+    t.Stop();
+    PrintTime("Partition Time", t.Seconds());
+    t.Start();
+    *neighs = AllocateArray<DestID_>(total);
+    pvector<SGOffset> offsets(num_nodes_ + 1);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t b=0; b < num_buckets; b++) {
+      NodeID_ first = b << shift;
+      NodeID_ last = std::min((b + 1) << shift, num_nodes_);
+      std::fill(&offsets[first], &offsets[last], 0);
+      for (SGOffset r = bucket_starts[b]; r < bucket_starts[b+1]; r++)
+        offsets[records[r].u]++;
+      SGOffset running = bucket_starts[b];
+      for (NodeID_ n = first; n < last; n++) {
+        SGOffset degree = offsets[n];
+        offsets[n] = running;
+        running += degree;
+      }
+      for (SGOffset r = bucket_starts[b]; r < bucket_starts[b+1]; r++)
+        (*neighs)[offsets[records[r].u]++] = records[r].v;
+      // revert offsets by shifting them down
+      for (NodeID_ n = last - 1; n > first; n--)
+        offsets[n] = offsets[n-1];
+      offsets[first] = bucket_starts[b];
+    }
+    offsets[num_nodes_] = total;
+    *index = CSROffsets::Adopt(std::move(offsets));
+    t.Stop();
+    PrintTime("Slice Time", t.Seconds());
+  }
+
   CSRGraph<NodeID_, DestID_, invert> MakeGraphFromEL(EdgeList &el) {
-    DestID_ **index = nullptr, **inv_index = nullptr;
+    CSROffsets index, inv_index;
     DestID_ *neighs = nullptr, *inv_neighs = nullptr;
     Timer t;
     t.Start();
@@ -325,6 +769,11 @@ class BuilderBase {
       Generator<NodeID_, DestID_, WeightT_>::InsertWeights(el);
     if (in_place_) {
       MakeCSRInPlace(el, &index, &neighs, &inv_index, &inv_neighs);
+    } else if (partitioned_) {
+      MakeCSRPartitioned(el, false, &index, &neighs);
+      if (!symmetrize_ && invert) {
+        MakeCSRPartitioned(el, true, &inv_index, &inv_neighs);
+      }
     } else {
       MakeCSR(el, false, &index, &neighs);
       if (!symmetrize_ && invert) {
@@ -340,27 +789,141 @@ class BuilderBase {
                                                 inv_index, inv_neighs);
   }
 
-  CSRGraph<NodeID_, DestID_, invert> MakeGraph() {
+  // Returns the edges from file or generator without building a graph
+  //  - Weights are only inserted (if needed) when insert_weights is set,
+  //    otherwise MakeGraphFromEL inserts them
+  //  - Also picks up the number of vertices if the file records it
+  EdgeList MakeEdgeList(bool insert_weights = false) {
+    EdgeList el;
+    if (cli_.filename() != "") {
+      Reader<NodeID_, DestID_, WeightT_, invert> r(cli_.filename());
+      el = r.ReadFile(needs_weights_);
+      if (r.num_nodes() != -1)
+        num_nodes_ = r.num_nodes();
+    } else if (cli_.scale() != -1) {
+      Generator<NodeID_, DestID_> gen(cli_.scale(), cli_.degree());
+      el = gen.GenerateEL(cli_.graph_type());
+    }
+    if (insert_weights && needs_weights_) {
+      Generator<NodeID_, DestID_, WeightT_>::InsertWeights(el);
+      needs_weights_ = false;
+    }
+    return el;
+  }
+
+  // Number of vertices if known before building, otherwise -1
+  int64_t num_nodes() const { return num_nodes_; }
+
+  CSRGraph<NodeID_, DestID_, invert> MakeSquishedGraph() {
+    if (cli_.shared_graph() != "")
+      return AttachSharedGraph();
+    if (cli_.filename() != "") {
+      Reader<NodeID_, DestID_, WeightT_, invert> r(cli_.filename());
+      if (r.GetSuffix() == ".csg") {
+        std::cout << ".csg graphs need a compressed build (COMPRESSED=TRUE)"
+                  << std::endl;
+        std::exit(-5);
+      }
+      if ((r.GetSuffix() == ".sg") || (r.GetSuffix() == ".wsg")) {
+        if (cli_.mmap_hints() != "")
+          return r.MapSerializedGraph(cli_.mmap_hints(),
+                                      cli_.verify_checksums());
+        return r.ReadSerializedGraph(cli_.verify_checksums());
+      }
+    }
+    if ((cli_.cache_dir() != "") && (cli_.scale() != -1))
+      return MakeCachedGraph();
+    return BuildSquishedGraph();
+  }
+
+  // Builds from an edge list (or the generator), never from a serialized graph
+  CSRGraph<NodeID_, DestID_, invert> BuildSquishedGraph() {
     CSRGraph<NodeID_, DestID_, invert> g;
     {  // extra scope to trigger earlier deletion of el (save memory)
-      EdgeList el;
-      if (cli_.filename() != "") {
-        Reader<NodeID_, DestID_, WeightT_, invert> r(cli_.filename());
-        if ((r.GetSuffix() == ".sg") || (r.GetSuffix() == ".wsg")) {
-          return r.ReadSerializedGraph();
-        } else {
-          el = r.ReadFile(needs_weights_);
-        }
-      } else if (cli_.scale() != -1) {
-        Generator<NodeID_, DestID_> gen(cli_.scale(), cli_.degree());
-        el = gen.GenerateEL(cli_.graph_type());
-      }
+      if (BuildsFromGenerator())
+        return MakeGraphFromGenerator();
+      EdgeList el = MakeEdgeList();
       g = MakeGraphFromEL(el);
     }
     if (in_place_)
       return g;
-    else
-      return SquishGraph(g);
+    Timer t;
+    t.Start();
+    g = SquishGraph(g);
+    t.Stop();
+    PrintTime("Squish Time", t.Seconds());
+    return g;
+  }
+
+  CSRGraph<NodeID_, DestID_, invert> AttachSharedGraph() {
+    std::string filename = SharedGraphFilename(
+      cli_.shared_graph(), !std::is_same<NodeID_, DestID_>::value);
+    if (access(filename.c_str(), R_OK) != 0) {
+      std::cout << "No graph published as " << filename
+                << " (publish it with graphd)" << std::endl;
+      std::exit(-6);
+    }
+    PrintLabel("Shared Graph", filename);
+    Reader<NodeID_, DestID_, WeightT_, invert> r(filename);
+    return r.MapSerializedGraph(cli_.mmap_hints() != "" ? cli_.mmap_hints()
+                                                        : "none",
+                                cli_.verify_checksums());
+  }
+
+  // Name of a cached synthetic graph, made of everything that determines it
+  std::string CachedGraphFilename() const {
+    bool weighted = !std::is_same<NodeID_, DestID_>::value;
+    return cli_.cache_dir() + "/" + GraphTypeToString(cli_.graph_type()) +
+           "-g" + std::to_string(cli_.scale()) +
+           "-k" + std::to_string(cli_.degree()) +
+           (symmetrize_ ? "-sym" : "-dir") +
+           "-seed" + std::to_string(kRandSeed) +
+           "-id" + std::to_string(8 * sizeof(NodeID_)) +
+           "-v" + std::to_string(kGeneratorVersion) +
+           (weighted ? ".wsg" : ".sg");
+  }
+
+  // Maps the cached synthetic graph, or builds and caches it if missing. The
+  // graph is written to a temporary name and renamed, so concurrent runs
+  // never map a partially written graph.
+  CSRGraph<NodeID_, DestID_, invert> MakeCachedGraph() {
+    std::string filename = CachedGraphFilename();
+    if (access(filename.c_str(), R_OK) == 0) {
+      PrintLabel("Cached Graph", filename);
+      Reader<NodeID_, DestID_, WeightT_, invert> r(filename);
+      return r.MapSerializedGraph(cli_.mmap_hints() != "" ? cli_.mmap_hints()
+                                                          : "none",
+                                  cli_.verify_checksums());
+    }
+    CSRGraph<NodeID_, DestID_, invert> g = BuildSquishedGraph();
+    Timer t;
+    t.Start();
+    std::string temp_filename = filename + ".tmp" + std::to_string(getpid());
+    WriterBase<NodeID_, DestID_> w(g);
+    w.WriteGraph(temp_filename, true);
+    if (std::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+      std::cout << "Couldn't cache graph as " << filename << std::endl;
+      std::remove(temp_filename.c_str());
+    }
+    t.Stop();
+    PrintTime("Cache Time", t.Seconds());
+    return g;
+  }
+
+  CSRGraph<NodeID_, DestID_, invert> MakeGraph() {
+    CSRGraph<NodeID_, DestID_, invert> g = MakeSquishedGraph();
+    if (cli_.relabel() != RelabelStrategy::NONE)
+      g = Relabel(g, cli_.relabel());
+    return g;
+  }
+
+  CompressedCSRGraph<NodeID_, invert> MakeCompressedGraph() {
+    if (cli_.filename() != "") {
+      Reader<NodeID_, DestID_, WeightT_, invert> r(cli_.filename());
+      if (r.GetSuffix() == ".csg")
+        return r.ReadCompressedGraph();
+    }
+    return CompressedCSRGraph<NodeID_, invert>(MakeGraph());
   }
 
   // Relabels (and rebuilds) graph by order of decreasing degree
@@ -373,6 +936,31 @@ class BuilderBase {
     }
     Timer t;
     t.Start();
+    CSRGraph<NodeID_, DestID_, invert> relabeled =
+      RelabelByMapping(g, DegreeOrder(g));
+    t.Stop();
+    PrintTime("Relabel", t.Seconds());
+    return relabeled;
+  }
+  /*
+  Relabeling Strategies (new_ids[old] = new)
+    - DEGREE: by decreasing degree (as RelabelByDegree)
+    - DBG: degree-based grouping, vertices binned by degree relative to the
+      average degree (hottest bin first), original order kept within bins
+    - BFS: order of a BFS from the highest degree vertex (per component)
+    - RCM: reverse Cuthill-McKee, BFS from a low degree vertex visiting
+      neighbors by increasing degree (per component), reversed
+    - GORDER: greedy Gorder approximation, appends the vertex sharing most
+      neighbors and edges with the last kGorderWindow placed vertices, only
+      counts shared neighbors through vertices of degree <= kGorderHubDegree
+  Directed graphs are ordered by their outgoing edges
+  */
+  static const int kDBGBins = 9;
+  static const int kGorderWindow = 5;
+  static const int64_t kGorderHubDegree = 32;
+
+  static
+  pvector<NodeID_> DegreeOrder(const CSRGraph<NodeID_, DestID_, invert> &g) {
     typedef std::pair<int64_t, NodeID_> degree_node_p;
     pvector<degree_node_p> degree_id_pairs(g.num_nodes());
     #pragma omp parallel for
@@ -380,25 +968,231 @@ class BuilderBase {
       degree_id_pairs[n] = std::make_pair(g.out_degree(n), n);
     std::sort(degree_id_pairs.begin(), degree_id_pairs.end(),
               std::greater<degree_node_p>());
-    pvector<NodeID_> degrees(g.num_nodes());
     pvector<NodeID_> new_ids(g.num_nodes());
     #pragma omp parallel for
-    for (NodeID_ n=0; n < g.num_nodes(); n++) {
-      degrees[n] = degree_id_pairs[n].first;
+    for (NodeID_ n=0; n < g.num_nodes(); n++)
       new_ids[degree_id_pairs[n].second] = n;
+    return new_ids;
+  }
+
+  static
+  pvector<NodeID_> DBGOrder(const CSRGraph<NodeID_, DestID_, invert> &g) {
+    double avg_degree = static_cast<double>(g.num_edges_directed()) /
+                        g.num_nodes();
+    auto bin_of = [&g, avg_degree](NodeID_ n) {
+      int bin = 0;
+      double threshold = avg_degree;
+      while ((bin < kDBGBins - 1) && (g.out_degree(n) >= threshold)) {
+        bin++;
+        threshold *= 2;
+      }
+      return kDBGBins - 1 - bin;
+    };
+    std::vector<SGOffset> bin_starts(kDBGBins + 1, 0);
+    for (NodeID_ n=0; n < g.num_nodes(); n++)
+      bin_starts[bin_of(n) + 1]++;
+    for (int b=0; b < kDBGBins; b++)
+      bin_starts[b+1] += bin_starts[b];
+    pvector<NodeID_> new_ids(g.num_nodes());
+    for (NodeID_ n=0; n < g.num_nodes(); n++)
+      new_ids[n] = bin_starts[bin_of(n)]++;
+    return new_ids;
+  }
+
+  // Visits all vertices in BFS order, starting a new BFS from the next vertex
+  // of roots for every component, optionally visiting neighbors by degree
+  static
+  pvector<NodeID_> BFSOrder(const CSRGraph<NodeID_, DestID_, invert> &g,
+                            const pvector<NodeID_> &roots,
+                            bool by_degree) {
+    pvector<NodeID_> order(g.num_nodes());
+    pvector<bool> visited(g.num_nodes(), false);
+    std::vector<NodeID_> neighbors;
+    int64_t head = 0, tail = 0;
+    for (NodeID_ root : roots) {
+      if (visited[root])
+        continue;
+      visited[root] = true;
+      order[tail++] = root;
+      while (head < tail) {
+        NodeID_ u = order[head++];
+        neighbors.clear();
+        for (NodeID_ v : g.out_neigh(u)) {
+          if (!visited[v]) {
+            visited[v] = true;
+            neighbors.push_back(v);
+          }
+        }
+        if (by_degree) {
+          std::stable_sort(neighbors.begin(), neighbors.end(),
+                           [&g](NodeID_ a, NodeID_ b) {
+                             return g.out_degree(a) < g.out_degree(b);
+                           });
+        }
+        for (NodeID_ v : neighbors)
+          order[tail++] = v;
+      }
     }
-    pvector<SGOffset> offsets = ParallelPrefixSum(degrees);
-    DestID_* neighs = new DestID_[offsets[g.num_nodes()]];
-    DestID_** index = CSRGraph<NodeID_, DestID_>::GenIndex(offsets, neighs);
-    #pragma omp parallel for
-    for (NodeID_ u=0; u < g.num_nodes(); u++) {
-      for (NodeID_ v : g.out_neigh(u))
-        neighs[offsets[new_ids[u]]++] = new_ids[v];
-      std::sort(index[new_ids[u]], index[new_ids[u]+1]);
+    return order;
+  }
+
+  static
+  pvector<NodeID_> GorderOrder(const CSRGraph<NodeID_, DestID_, invert> &g,
+                               const pvector<NodeID_> &by_degree) {
+    typedef std::pair<int64_t, NodeID_> score_node_p;
+    pvector<NodeID_> order(g.num_nodes());
+    pvector<bool> placed(g.num_nodes(), false);
+    pvector<int64_t> score(g.num_nodes(), 0);
+    std::priority_queue<score_node_p> candidates;
+    auto update = [&](NodeID_ v, int64_t delta) {
+      auto bump = [&](NodeID_ u) {
+        if (placed[u])
+          return;
+        score[u] += delta;
+        if (delta > 0)
+          candidates.push(std::make_pair(score[u], u));
+      };
+      for (NodeID_ u : g.out_neigh(v)) {
+        bump(u);
+        if (g.out_degree(u) <= kGorderHubDegree) {
+          for (NodeID_ w : g.out_neigh(u))
+            if (w != v)
+              bump(w);
+        }
+      }
+    };
+    // Max-heap with lazy deletion, stale entries are dropped or re-pushed
+    auto next_candidate = [&]() {
+      while (!candidates.empty()) {
+        score_node_p top = candidates.top();
+        candidates.pop();
+        NodeID_ u = top.second;
+        if (placed[u])
+          continue;
+        if (top.first == score[u])
+          return u;
+        if (score[u] > 0)
+          candidates.push(std::make_pair(score[u], u));
+      }
+      return static_cast<NodeID_>(-1);
+    };
+    int64_t next_by_degree = 0;
+    for (int64_t i=0; i < g.num_nodes(); i++) {
+      NodeID_ v = next_candidate();
+      if (v == -1) {
+        while (placed[by_degree[next_by_degree]])
+          next_by_degree++;
+        v = by_degree[next_by_degree];
+      }
+      placed[v] = true;
+      order[i] = v;
+      update(v, 1);
+      if (i >= kGorderWindow)
+        update(order[i - kGorderWindow], -1);
     }
+    return order;
+  }
+
+  static DestID_ RenameDest(NodeID_ v, const pvector<NodeID_> &new_ids) {
+    return new_ids[v];
+  }
+
+  static DestID_ RenameDest(NodeWeight<NodeID_, WeightT_> v,
+                            const pvector<NodeID_> &new_ids) {
+    return NodeWeight<NodeID_, WeightT_>(new_ids[v.v], v.w);
+  }
+
+  // Rebuilds g with every vertex n renamed to new_ids[n], neighbors sorted
+  static
+  CSRGraph<NodeID_, DestID_, invert> RelabelByMapping(
+      const CSRGraph<NodeID_, DestID_, invert> &g,
+      const pvector<NodeID_> &new_ids) {
+    auto rebuild = [&](bool transpose, CSROffsets* index, DestID_** neighs) {
+      pvector<NodeID_> degrees(g.num_nodes());
+      #pragma omp parallel for
+      for (NodeID_ n=0; n < g.num_nodes(); n++) {
+        if constexpr (invert)
+          degrees[new_ids[n]] = transpose ? g.in_degree(n) : g.out_degree(n);
+        else
+          degrees[new_ids[n]] = g.out_degree(n);
+      }
+      pvector<SGOffset> offsets = ParallelPrefixSum(degrees);
+      *neighs = AllocateArray<DestID_>(offsets[g.num_nodes()]);
+      #pragma omp parallel for schedule(dynamic, 1024)
+      for (NodeID_ u=0; u < g.num_nodes(); u++) {
+        DestID_* start = *neighs + offsets[new_ids[u]];
+        DestID_* pos = start;
+        if constexpr (invert) {
+          if (transpose) {
+            for (DestID_ v : g.in_neigh(u))
+              *pos++ = RenameDest(v, new_ids);
+          }
+        }
+        if (!transpose) {
+          for (DestID_ v : g.out_neigh(u))
+            *pos++ = RenameDest(v, new_ids);
+        }
+        std::sort(start, pos);
+      }
+      *index = CSROffsets::Adopt(std::move(offsets));
+    };
+    CSROffsets out_index, in_index;
+    DestID_ *out_neighs = nullptr, *in_neighs = nullptr;
+    rebuild(false, &out_index, &out_neighs);
+    if (!g.directed())
+      return CSRGraph<NodeID_, DestID_, invert>(g.num_nodes(), out_index,
+                                                out_neighs);
+    if (invert)
+      rebuild(true, &in_index, &in_neighs);
+    return CSRGraph<NodeID_, DestID_, invert>(g.num_nodes(), out_index,
+                                              out_neighs, in_index, in_neighs);
+  }
+
+  static
+  CSRGraph<NodeID_, DestID_, invert> Relabel(
+      const CSRGraph<NodeID_, DestID_, invert> &g, RelabelStrategy strategy) {
+    Timer t;
+    t.Start();
+    pvector<NodeID_> new_ids(g.num_nodes());
+    auto invert_order = [&new_ids](const pvector<NodeID_> &order, bool rev) {
+      #pragma omp parallel for
+      for (size_t i=0; i < order.size(); i++)
+        new_ids[order[i]] = rev ? order.size() - 1 - i : i;
+    };
+    switch (strategy) {
+      case RelabelStrategy::DEGREE:
+        new_ids = DegreeOrder(g);
+        break;
+      case RelabelStrategy::DBG:
+        new_ids = DBGOrder(g);
+        break;
+      case RelabelStrategy::BFS:
+      case RelabelStrategy::RCM:
+      case RelabelStrategy::GORDER: {
+        // Roots ordered by degree (decreasing for BFS/Gorder, increasing for
+        // RCM, where low degree approximates a peripheral vertex)
+        pvector<NodeID_> by_degree(g.num_nodes());
+        pvector<NodeID_> degree_ids = DegreeOrder(g);
+        bool rcm = strategy == RelabelStrategy::RCM;
+        #pragma omp parallel for
+        for (NodeID_ n=0; n < g.num_nodes(); n++)
+          by_degree[rcm ? g.num_nodes() - 1 - degree_ids[n] : degree_ids[n]] = n;
+        if (strategy == RelabelStrategy::GORDER)
+          invert_order(GorderOrder(g, by_degree), false);
+        else
+          invert_order(BFSOrder(g, by_degree, rcm), rcm);
+        break;
+      }
+      default:
+        #pragma omp parallel for
+        for (NodeID_ n=0; n < g.num_nodes(); n++)
+          new_ids[n] = n;
+    }
+    CSRGraph<NodeID_, DestID_, invert> relabeled = RelabelByMapping(g, new_ids);
     t.Stop();
-    PrintTime("Relabel", t.Seconds());
-    return CSRGraph<NodeID_, DestID_, invert>(g.num_nodes(), index, neighs);
+    PrintLabel("Relabel Strategy", RelabelStrategyToString(strategy));
+    PrintTime("Relabel Time", t.Seconds());
+    return relabeled;
   }
 };
 
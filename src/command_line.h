@@ -13,6 +13,8 @@
 #include <type_traits>
 #include <vector>
 
+#include "allocator.h"
+
 
 /*
 GAP Benchmark Suite
@@ -44,12 +46,34 @@ std::string GraphTypeToString(GraphType gt) {
 }
 
 
+enum class RelabelStrategy {
+  NONE,
+  DEGREE,
+  DBG,
+  BFS,
+  RCM,
+  GORDER
+};
+
+std::string RelabelStrategyToString(RelabelStrategy rs) {
+  switch (rs) {
+    case RelabelStrategy::NONE:   return "none";
+    case RelabelStrategy::DEGREE: return "degree";
+    case RelabelStrategy::DBG:    return "dbg";
+    case RelabelStrategy::BFS:    return "bfs";
+    case RelabelStrategy::RCM:    return "rcm";
+    case RelabelStrategy::GORDER: return "gorder";
+    default:                      return "unknown";
+  }
+}
+
+
 class CLBase {
  protected:
   int argc_;
   char** argv_;
   std::string name_;
-  std::string get_args_ = "f:g:hk:su:m";
+  std::string get_args_ = "f:g:hk:su:mPM:R:H:N:C:G:K";
   std::vector<std::string> help_strings_;
 
   int scale_ = -1;
@@ -58,6 +82,13 @@ class CLBase {
   bool symmetrize_ = false;
   bool uniform_ = false;
   bool in_place_ = false;
+  bool partitioned_ = false;
+  std::string mmap_hints_ = "";
+  std::string cache_dir_ = "";
+  std::string shared_graph_ = "";
+  bool verify_checksums_ = true;
+  RelabelStrategy relabel_ = RelabelStrategy::NONE;
+  PagePolicy page_policy_ = PagePolicy::MALLOC;
   GraphType graph_type_ = GraphType::KRONECKER;
 
   void AddHelpLine(char opt, std::string opt_arg, std::string text,
@@ -84,6 +115,14 @@ class CLBase {
     AddHelpLine('k', "degree", "average degree for synthetic graph",
                 std::to_string(degree_));
     AddHelpLine('m', "", "reduces memory usage during graph building", "false");
+    AddHelpLine('P', "", "radix-partitions edges to build without atomics", "false");
+    AddHelpLine('M', "hints", "mmap .sg/.wsg file (none,populate,willneed,random,...)", "read");
+    AddHelpLine('R', "order", "relabel vertices (degree, dbg, bfs, rcm, gorder)", "none");
+    AddHelpLine('H', "policy", "page policy for large arrays (malloc, thp, hugetlb)", "malloc");
+    AddHelpLine('N', "policy", "NUMA placement of large arrays (local, interleave[:nodes], bind:nodes)", "local");
+    AddHelpLine('C', "dir", "cache synthetic graphs in dir and map them later");
+    AddHelpLine('G', "name", "attach to graph published by graphd (shm:name or path)");
+    AddHelpLine('K', "", "skip checking .sg/.wsg checksums when loading", "false");
   }
 
   bool ParseArgs() {
@@ -92,7 +131,7 @@ class CLBase {
     while ((c_opt = getopt(argc_, argv_, get_args_.c_str())) != -1) {
       HandleArg(c_opt, optarg);
     }
-    if ((filename_ == "") && (scale_ == -1)) {
+    if ((filename_ == "") && (scale_ == -1) && (shared_graph_ == "")) {
       std::cout << "No graph input specified. (Use -h for help)" << std::endl;
       return false;
     }
@@ -110,9 +149,40 @@ class CLBase {
       case 's': symmetrize_ = true;                         break;
       case 'u': uniform_ = true; scale_ = atoi(opt_arg);    break;
       case 'm': in_place_ = true;                           break;
+      case 'P': partitioned_ = true;                        break;
+      case 'M': mmap_hints_ = std::string(opt_arg);         break;
+      case 'R': relabel_ = ParseRelabelStrategy(opt_arg);   break;
+      case 'H':
+        // Applies to every array allocated from here on
+        page_policy_ = ParsePagePolicy(opt_arg);
+        PageAllocator::set_policy(page_policy_);
+        break;
+      case 'N': PageAllocator::set_numa_policy(opt_arg);    break;
+      case 'C': cache_dir_ = std::string(opt_arg);          break;
+      case 'G': shared_graph_ = std::string(opt_arg);       break;
+      case 'K': verify_checksums_ = false;                  break;
     }
   }
 
+  static RelabelStrategy ParseRelabelStrategy(std::string name) {
+    for (RelabelStrategy rs : {RelabelStrategy::NONE, RelabelStrategy::DEGREE,
+                               RelabelStrategy::DBG, RelabelStrategy::BFS,
+                               RelabelStrategy::RCM, RelabelStrategy::GORDER})
+      if (name == RelabelStrategyToString(rs))
+        return rs;
+    std::cout << "Unknown relabel strategy: " << name << std::endl;
+    std::exit(-12);
+  }
+
+  static PagePolicy ParsePagePolicy(std::string name) {
+    for (PagePolicy pp : {PagePolicy::MALLOC, PagePolicy::THP,
+                          PagePolicy::HUGETLB})
+      if (name == PagePolicyToString(pp))
+        return pp;
+    std::cout << "Unknown page policy: " << name << std::endl;
+    std::exit(-12);
+  }
+
   void PrintUsage() {
     std::cout << name_ << std::endl;
     // std::sort(help_strings_.begin(), help_strings_.end());
@@ -127,6 +197,13 @@ class CLBase {
   bool symmetrize() const { return symmetrize_; }
   bool uniform() const { return uniform_; }
   bool in_place() const { return in_place_; }
+  bool partitioned() const { return partitioned_; }
+  std::string mmap_hints() const { return mmap_hints_; }
+  std::string cache_dir() const { return cache_dir_; }
+  std::string shared_graph() const { return shared_graph_; }
+  bool verify_checksums() const { return verify_checksums_; }
+  RelabelStrategy relabel() const { return relabel_; }
+  PagePolicy page_policy() const { return page_policy_; }
   GraphType graph_type() const { return graph_type_; }
 };
 
@@ -168,17 +245,30 @@ class CLApp : public CLBase {
 class CLBFSApp : public CLApp {
   std::string output_name_ = "";
   bool structured_output_ = false;
+  int64_t verify_samples_ = 0;
+  int num_warmups_ = 0;
+  double target_ci_width_ = 0;
+  int max_trials_ = 100;
 
  public:
   CLBFSApp(int argc, char** argv, std::string name) : CLApp(argc, argv, name) {
-    get_args_ += "o:t:";
+    get_args_ += "o:t:V:W:c:x:";
     AddHelpLine('o', "file", "enable structured output and write to given filename", "false");
+    AddHelpLine('V', "samples", "verify like -v, but only a random sample of vertices", "all");
+    AddHelpLine('W', "n", "perform n warm-up trials left out of the statistics",
+                std::to_string(num_warmups_));
+    AddHelpLine('c', "pct", "after -n trials, run more until the 95% CI of the median is within pct% of it", "off");
+    AddHelpLine('x', "n", "stop -c after n trials", std::to_string(max_trials_));
     AddHelpLine('t', "graph-type", "graph type (kronecker, uniform, par-chains, dimensional, binary-tree). For par-chains: should be run with -r 0, -k sets number of chains, -g sets chain length", "kronecker");
   }
 
   void HandleArg(signed char opt, char* opt_arg) override {
     switch (opt) {
       case 'o': structured_output_ = true; output_name_ = std::string(opt_arg); break;
+      case 'V': verify_samples_ = atol(opt_arg); CLApp::HandleArg('v', opt_arg); break;
+      case 'W': num_warmups_ = atoi(opt_arg); break;
+      case 'c': target_ci_width_ = atof(opt_arg) / 100; break;
+      case 'x': max_trials_ = atoi(opt_arg); break;
       case 't':
       if (std::string(opt_arg) == "kronecker") {
         graph_type_ = GraphType::KRONECKER;
@@ -201,9 +291,40 @@ class CLBFSApp : public CLApp {
 
   bool structured_output() const { return structured_output_; }
   std::string output_name() const { return output_name_; }
+  int64_t verify_samples() const { return verify_samples_; }
+  int num_warmups() const { return num_warmups_; }
+  bool adaptive_trials() const { return target_ci_width_ > 0; }
+  double target_ci_width() const { return target_ci_width_; }
+  int max_trials() const { return max_trials_; }
   std::string name() const { return name_; }
 };
 
+class CLDynamicBFSApp : public CLBFSApp {
+  int64_t batch_size_ = 1 << 16;
+  int64_t delete_size_ = 0;
+
+ public:
+  CLDynamicBFSApp(int argc, char** argv, std::string name) :
+      CLBFSApp(argc, argv, name) {
+    get_args_ += "b:d:";
+    AddHelpLine('b', "edges", "insert a batch of random edges per trial",
+                std::to_string(batch_size_));
+    AddHelpLine('d', "edges", "delete a batch of random edges per trial first (at most all left)",
+                std::to_string(delete_size_));
+  }
+
+  void HandleArg(signed char opt, char* opt_arg) override {
+    switch (opt) {
+      case 'b': batch_size_ = atol(opt_arg);            break;
+      case 'd': delete_size_ = atol(opt_arg);           break;
+      default: CLBFSApp::HandleArg(opt, opt_arg);
+    }
+  }
+
+  int64_t batch_size() const { return batch_size_; }
+  int64_t delete_size() const { return delete_size_; }
+};
+
 class CLIterApp : public CLApp {
   int num_iters_;
 
@@ -286,21 +407,34 @@ class CLConvert : public CLBase {
   bool out_weighted_ = false;
   bool out_el_ = false;
   bool out_sg_ = false;
+  bool out_csg_ = false;
+  bool out_raw_el_ = false;
+  int64_t memory_budget_ = 0;
+  std::string scratch_dir_ = "";
 
  public:
   CLConvert(int argc, char** argv, std::string name)
       : CLBase(argc, argv, name) {
-    get_args_ += "e:b:w";
+    get_args_ += "e:b:c:E:wX:T:";
     AddHelpLine('b', "file", "output serialized graph to file");
-    AddHelpLine('e', "file", "output edge list to file");
+    AddHelpLine('c', "file", "output compressed serialized graph to file (.csg)");
+    AddHelpLine('e', "file", "output edge list to file (binary if .bel/.wbel)");
+    AddHelpLine('E', "file", "output input edges unbuilt to .bel/.wbel file");
     AddHelpLine('w', "file", "make output weighted");
+    AddHelpLine('X', "mb", "build .sg out of core within memory budget (MB)");
+    AddHelpLine('T', "dir", "scratch directory for out-of-core runs",
+                "output's");
   }
 
   void HandleArg(signed char opt, char* opt_arg) override {
     switch (opt) {
       case 'b': out_sg_ = true; out_filename_ = std::string(opt_arg);   break;
+      case 'c': out_csg_ = true; out_filename_ = std::string(opt_arg);  break;
       case 'e': out_el_ = true; out_filename_ = std::string(opt_arg);   break;
+      case 'E': out_raw_el_ = true; out_filename_ = std::string(opt_arg); break;
       case 'w': out_weighted_ = true;                                   break;
+      case 'X': memory_budget_ = atol(opt_arg);                         break;
+      case 'T': scratch_dir_ = std::string(opt_arg);                    break;
       default: CLBase::HandleArg(opt, opt_arg);
     }
   }
@@ -309,6 +443,34 @@ class CLConvert : public CLBase {
   bool out_weighted() const { return out_weighted_; }
   bool out_el() const { return out_el_; }
   bool out_sg() const { return out_sg_; }
+  bool out_csg() const { return out_csg_; }
+  bool out_raw_el() const { return out_raw_el_; }
+  int64_t memory_budget() const { return memory_budget_; }
+  std::string scratch_dir() const { return scratch_dir_; }
+};
+
+class CLGraphd : public CLBase {
+  std::string publish_name_ = "";
+  bool weighted_ = false;
+
+ public:
+  CLGraphd(int argc, char** argv, std::string name)
+      : CLBase(argc, argv, name) {
+    get_args_ += "w";
+    AddHelpLine('w', "", "publish weighted graph", "false");
+  }
+
+  // -G names where to publish instead of where to attach
+  void HandleArg(signed char opt, char* opt_arg) override {
+    switch (opt) {
+      case 'G': publish_name_ = std::string(opt_arg); break;
+      case 'w': weighted_ = true;                     break;
+      default: CLBase::HandleArg(opt, opt_arg);
+    }
+  }
+
+  std::string publish_name() const { return publish_name_; }
+  bool weighted() const { return weighted_; }
 };
 
 #endif  // COMMAND_LINE_H_
@@ -0,0 +1,350 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef COMPRESSED_GRAPH_H_
+#define COMPRESSED_GRAPH_H_
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+#include "graph.h"
+#include "pvector.h"
+#include "timer.h"
+#include "util.h"
+
+
+/*
+GAP Benchmark Suite
+Class:  CompressedCSRGraph
+
+Read-only unweighted graph in CSR format with compressed neighborhoods
+ - Built from a CSRGraph (Builder) or read from a .csg file (Reader)
+ - Each neighborhood is a byte-aligned varint stream: the degree, the first
+   neighbor relative to the vertex itself (zigzag) and then the gaps between
+   the sorted neighbors
+ - CSROffsets hold the byte offset of each neighborhood
+ - Neighborhoods decode on the fly, so kernels only written with range-based
+   for loops over out_neigh/in_neigh work unchanged (e.g., bfs with
+   COMPRESSED_GRAPH defined)
+*/
+
+
+namespace varint {
+
+inline uint64_t Decode(const uint8_t* &pos) {
+  uint64_t value = *pos++;
+  if (value < 0x80)
+    return value;
+  value &= 0x7f;
+  int shift = 7;
+  uint8_t byte;
+  do {
+    byte = *pos++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte >= 0x80);
+  return value;
+}
+
+inline uint8_t* Encode(uint64_t value, uint8_t* pos) {
+  while (value >= 0x80) {
+    *pos++ = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  *pos++ = static_cast<uint8_t>(value);
+  return pos;
+}
+
+inline int64_t Size(uint64_t value) {
+  int64_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+inline uint64_t ZigZag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t UnZigZag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+}  // namespace varint
+
+
+template <class NodeID_, bool MakeInverse = true>
+class CompressedCSRGraph {
+  // Used for *non-negative* offsets within a neighborhood
+  typedef std::make_unsigned<std::ptrdiff_t>::type OffsetT;
+
+  // Decodes one neighborhood while iterating over it
+  class NeighborIterator {
+    const uint8_t* pos_;
+    int64_t remaining_;
+    NodeID_ value_;
+   public:
+    NeighborIterator() : pos_(nullptr), remaining_(0), value_(0) {}
+    NeighborIterator(const uint8_t* pos, int64_t remaining, NodeID_ value) :
+        pos_(pos), remaining_(remaining), value_(value) {}
+    NodeID_ operator*() const { return value_; }
+    NeighborIterator& operator++() {
+      if (--remaining_ > 0)
+        value_ += static_cast<NodeID_>(varint::Decode(pos_));
+      return *this;
+    }
+    bool operator!=(const NeighborIterator &other) const {
+      return remaining_ != other.remaining_;
+    }
+    bool operator==(const NeighborIterator &other) const {
+      return remaining_ == other.remaining_;
+    }
+  };
+
+  class Neighborhood {
+    NeighborIterator begin_;
+   public:
+    Neighborhood(NodeID_ n, const uint8_t* pos, OffsetT start_offset) {
+      int64_t degree = varint::Decode(pos);
+      if (degree == 0)
+        return;
+      NodeID_ first = n + varint::UnZigZag(varint::Decode(pos));
+      begin_ = NeighborIterator(pos, degree, first);
+      for (OffsetT i=0; i < start_offset && begin_ != end(); i++)
+        ++begin_;
+    }
+    typedef NeighborIterator iterator;
+    iterator begin() { return begin_; }
+    iterator end()   { return NeighborIterator(); }
+  };
+
+  // Encodes all neighborhoods of one direction of g
+  static void Compress(const CSRGraph<NodeID_, NodeID_, MakeInverse> &g,
+                       bool transpose, CSROffsets* index, uint8_t** bytes) {
+    auto neigh = [&g, transpose](NodeID_ n) {
+      return transpose ? g.in_neigh(n) : g.out_neigh(n);
+    };
+    // Neighborhoods are sorted by the builder, but sort (a copy) if needed
+    auto sorted = [&neigh](NodeID_ n, std::vector<NodeID_> &buffer) {
+      buffer.assign(neigh(n).begin(), neigh(n).end());
+      if (!std::is_sorted(buffer.begin(), buffer.end()))
+        std::sort(buffer.begin(), buffer.end());
+    };
+    pvector<SGOffset> offsets(g.num_nodes() + 1);
+    #pragma omp parallel
+    {
+      std::vector<NodeID_> buffer;
+      #pragma omp for schedule(dynamic, 1024)
+      for (NodeID_ n=0; n < g.num_nodes(); n++) {
+        sorted(n, buffer);
+        int64_t size = varint::Size(buffer.size());
+        for (size_t i=0; i < buffer.size(); i++) {
+          int64_t delta = i == 0 ? buffer[0] - n : buffer[i] - buffer[i-1];
+          size += varint::Size(i == 0 ? varint::ZigZag(delta) : delta);
+        }
+        offsets[n] = size;
+      }
+    }
+    SGOffset total = 0;
+    for (NodeID_ n=0; n < g.num_nodes(); n++) {
+      SGOffset size = offsets[n];
+      offsets[n] = total;
+      total += size;
+    }
+    offsets[g.num_nodes()] = total;
+    *bytes = AllocateArray<uint8_t>(total);
+    #pragma omp parallel
+    {
+      std::vector<NodeID_> buffer;
+      #pragma omp for schedule(dynamic, 1024)
+      for (NodeID_ n=0; n < g.num_nodes(); n++) {
+        sorted(n, buffer);
+        uint8_t* pos = varint::Encode(buffer.size(), *bytes + offsets[n]);
+        for (size_t i=0; i < buffer.size(); i++) {
+          int64_t delta = i == 0 ? buffer[0] - n : buffer[i] - buffer[i-1];
+          pos = varint::Encode(i == 0 ? varint::ZigZag(delta) : delta, pos);
+        }
+      }
+    }
+    *index = CSROffsets::Adopt(std::move(offsets));
+  }
+
+  void ReleaseResources() {
+    out_offsets_.Delete();
+    FreeArray(out_bytes_);
+    if (directed_) {
+      in_offsets_.Delete();
+      FreeArray(in_bytes_);
+    }
+  }
+
+ public:
+  CompressedCSRGraph() : directed_(false), num_nodes_(-1), num_edges_(-1),
+    out_bytes_(nullptr), in_bytes_(nullptr) {}
+
+  // Takes ownership of the arrays (as read by Reader)
+  CompressedCSRGraph(bool directed, int64_t num_nodes,
+                     int64_t num_edges_directed,
+                     CSROffsets out_offsets, uint8_t* out_bytes,
+                     CSROffsets in_offsets = CSROffsets(),
+                     uint8_t* in_bytes = nullptr) :
+    directed_(directed), num_nodes_(num_nodes),
+    num_edges_(directed ? num_edges_directed : num_edges_directed / 2),
+    out_offsets_(out_offsets), out_bytes_(out_bytes),
+    in_offsets_(directed ? in_offsets : out_offsets),
+    in_bytes_(directed ? in_bytes : out_bytes) {}
+
+  explicit CompressedCSRGraph(const CSRGraph<NodeID_, NodeID_, MakeInverse> &g)
+      : directed_(g.directed()), num_nodes_(g.num_nodes()),
+        num_edges_(g.num_edges()), in_bytes_(nullptr) {
+    Timer t;
+    t.Start();
+    Compress(g, false, &out_offsets_, &out_bytes_);
+    if (directed_ && MakeInverse) {
+      Compress(g, true, &in_offsets_, &in_bytes_);
+    } else if (!directed_) {
+      in_offsets_ = out_offsets_;
+      in_bytes_ = out_bytes_;
+    }
+    t.Stop();
+    PrintTime("Compress Time", t.Seconds());
+  }
+
+  CompressedCSRGraph(const CompressedCSRGraph&) = delete;
+  CompressedCSRGraph& operator=(const CompressedCSRGraph&) = delete;
+
+  CompressedCSRGraph(CompressedCSRGraph&& other) : directed_(other.directed_),
+    num_nodes_(other.num_nodes_), num_edges_(other.num_edges_),
+    out_offsets_(other.out_offsets_), out_bytes_(other.out_bytes_),
+    in_offsets_(other.in_offsets_), in_bytes_(other.in_bytes_) {
+      other.num_edges_ = -1;
+      other.num_nodes_ = -1;
+      other.out_offsets_ = CSROffsets();
+      other.out_bytes_ = nullptr;
+      other.in_offsets_ = CSROffsets();
+      other.in_bytes_ = nullptr;
+  }
+
+  CompressedCSRGraph& operator=(CompressedCSRGraph&& other) {
+    if (this != &other) {
+      ReleaseResources();
+      directed_ = other.directed_;
+      num_edges_ = other.num_edges_;
+      num_nodes_ = other.num_nodes_;
+      out_offsets_ = other.out_offsets_;
+      out_bytes_ = other.out_bytes_;
+      in_offsets_ = other.in_offsets_;
+      in_bytes_ = other.in_bytes_;
+      other.num_edges_ = -1;
+      other.num_nodes_ = -1;
+      other.out_offsets_ = CSROffsets();
+      other.out_bytes_ = nullptr;
+      other.in_offsets_ = CSROffsets();
+      other.in_bytes_ = nullptr;
+    }
+    return *this;
+  }
+
+  ~CompressedCSRGraph() {
+    ReleaseResources();
+  }
+
+  bool directed() const {
+    return directed_;
+  }
+
+  int64_t num_nodes() const {
+    return num_nodes_;
+  }
+
+  int64_t num_edges() const {
+    return num_edges_;
+  }
+
+  int64_t num_edges_directed() const {
+    return directed_ ? num_edges_ : 2*num_edges_;
+  }
+
+  int64_t out_degree(NodeID_ v) const {
+    const uint8_t* pos = out_bytes_ + out_offsets_[v];
+    return varint::Decode(pos);
+  }
+
+  int64_t in_degree(NodeID_ v) const {
+    static_assert(MakeInverse, "Graph inversion disabled but reading inverse");
+    const uint8_t* pos = in_bytes_ + in_offsets_[v];
+    return varint::Decode(pos);
+  }
+
+  Neighborhood out_neigh(NodeID_ n, OffsetT start_offset = 0) const {
+    return Neighborhood(n, out_bytes_ + out_offsets_[n], start_offset);
+  }
+
+  Neighborhood in_neigh(NodeID_ n, OffsetT start_offset = 0) const {
+    static_assert(MakeInverse, "Graph inversion disabled but reading inverse");
+    return Neighborhood(n, in_bytes_ + in_offsets_[n], start_offset);
+  }
+
+  void PrintStats() const {
+    PrintAligned("Nodes", num_nodes_);
+    PrintAligned("Edges", num_edges_);
+    PrintLabel("Directed", directed_ ? "Yes" : "No");
+    PrintAligned("Degree", num_edges_/num_nodes_);
+    PrintMaxDegree();
+    PrintAligned("Encoded Bytes", out_offsets_[num_nodes_]);
+  }
+
+  void PrintTopology() const {
+    for (NodeID_ i=0; i < num_nodes_; i++) {
+      std::cout << i << ": ";
+      for (NodeID_ j : out_neigh(i)) {
+        std::cout << j << " ";
+      }
+      std::cout << std::endl;
+    }
+  }
+
+  void PrintMaxDegree() const {
+    int64_t max_degree = 0;
+    #pragma omp parallel for reduction(max : max_degree)
+    for (NodeID_ n=0; n < num_nodes_; n++)
+      max_degree = std::max(max_degree, out_degree(n));
+    PrintAligned("Max Degree", max_degree);
+  }
+
+  // Byte offsets and encoded neighborhoods, as written to a .csg file
+  pvector<SGOffset> ByteOffsets(bool in_graph = false) const {
+    const CSROffsets &index = in_graph ? in_offsets_ : out_offsets_;
+    pvector<SGOffset> offsets(num_nodes_+1);
+    #pragma omp parallel for
+    for (NodeID_ n=0; n < num_nodes_+1; n++)
+      offsets[n] = index[n];
+    return offsets;
+  }
+
+  const uint8_t* bytes(bool in_graph = false) const {
+    return in_graph ? in_bytes_ : out_bytes_;
+  }
+
+  Range<NodeID_> vertices() const {
+    return Range<NodeID_>(num_nodes());
+  }
+
+ private:
+  bool directed_;
+  int64_t num_nodes_;
+  int64_t num_edges_;
+  CSROffsets out_offsets_;
+  uint8_t*   out_bytes_;
+  CSROffsets in_offsets_;
+  uint8_t*   in_bytes_;
+};
+
+#endif  // COMPRESSED_GRAPH_H_
@@ -6,6 +6,7 @@
 #include "benchmark.h"
 #include "builder.h"
 #include "command_line.h"
+#include "external_builder.h"
 #include "graph.h"
 #include "writer.h"
 
@@ -14,7 +15,28 @@ using namespace std;
 int main(int argc, char* argv[]) {
   CLConvert cli(argc, argv, "converter");
   cli.ParseArgs();
-  if (cli.out_weighted()) {
+  if (cli.memory_budget() > 0) {   // graph too large to build in memory
+    if (!cli.out_sg()) {
+      cout << "Out-of-core building only writes serialized graphs (-b)"
+           << endl;
+      return -36;
+    }
+    if (cli.out_weighted()) {
+      ExternalBuilder<NodeID, WNode, WeightT> bw(cli);
+      bw.WriteSerializedGraph(cli.out_filename());
+    } else {
+      ExternalBuilder<NodeID> b(cli);
+      b.WriteSerializedGraph(cli.out_filename());
+    }
+  } else if (cli.out_raw_el()) {   // skips building, e.g., to reuse generated edges
+    if (cli.out_weighted()) {
+      WeightedBuilder bw(cli);
+      WriteBinaryEL(cli.out_filename(), bw.MakeEdgeList(true), bw.num_nodes());
+    } else {
+      Builder b(cli);
+      WriteBinaryEL(cli.out_filename(), b.MakeEdgeList(), b.num_nodes());
+    }
+  } else if (cli.out_weighted()) {
     WeightedBuilder bw(cli);
     WGraph wg = bw.MakeGraph();
     wg.PrintStats();
@@ -25,7 +47,7 @@ int main(int argc, char* argv[]) {
     Graph g = b.MakeGraph();
     g.PrintStats();
     Writer w(g);
-    w.WriteGraph(cli.out_filename(), cli.out_sg());
+    w.WriteGraph(cli.out_filename(), cli.out_sg(), cli.out_csg());
   }
   return 0;
 }
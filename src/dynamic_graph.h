@@ -0,0 +1,495 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef DYNAMIC_GRAPH_H_
+#define DYNAMIC_GRAPH_H_
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "graph.h"
+#include "pvector.h"
+#include "util.h"
+
+
+/*
+GAP Benchmark Suite
+Class:  DynamicGraph
+
+Unweighted graph that changes by batches of edge insertions and deletions
+ - Wraps a built graph (CSRGraph or CompressedCSRGraph), which stays as is
+ - Inserted neighbors go into per-vertex chains of cache-line sized overflow
+   blocks, newest block first, and only the first block gets filled up
+ - Deleted neighbors are removed from the chain in place, deleted built
+   neighbors are recorded in a sorted array per vertex (tombstones) that
+   grows by doubling; inserting a deleted built edge again revives it
+ - Built neighborhoods are sorted (as every builder leaves them), so
+   iterating merges the tombstones against them and costs
+   O(degree + tombstones), and lookups into them are binary searches
+ - InsertEdges/DeleteEdges sort a batch, drop self loops and duplicates
+   within it and change the chains in parallel with one task per source
+   vertex, so no atomics are needed; the new blocks of a batch are allocated
+   at once
+ - Inserted edges are not looked up in the graph, so re-inserting an
+   existing edge makes it a parallel edge (harmless for traversals), and
+   deleting an edge removes all of its copies
+ - Neighborhoods iterate the built neighbors and then the chain, so kernels
+   only written with range-based for loops over out_neigh/in_neigh work
+   unchanged
+*/
+
+
+template <class NodeID_, class BaseGraph_ = CSRGraph<NodeID_>>
+class DynamicGraph {
+  typedef EdgePair<NodeID_, NodeID_> Edge;
+  typedef decltype(std::declval<const BaseGraph_&>().out_neigh(0))
+    BaseNeighborhood;
+  typedef typename BaseNeighborhood::iterator BaseIterator;
+
+  // Overflow neighbors of one vertex, one cache line
+  struct Block {
+    static const int32_t kCapacity =
+      (64 - sizeof(Block*) - sizeof(int32_t)) / sizeof(NodeID_);
+    Block* next;
+    int32_t size;
+    NodeID_ neighs[kCapacity];
+  };
+
+  // Deleted built neighbors of one vertex, sorted
+  struct Tombstones {
+    NodeID_* ids;
+    int64_t size;
+    int64_t capacity;
+  };
+
+  // Walks the built neighbors not deleted and then the blocks of the chain,
+  // both the built neighbors and the tombstones are sorted so the deleted
+  // ones are skipped by merging
+  class NeighborIterator {
+    BaseIterator base_;
+    BaseIterator base_end_;
+    const NodeID_* deleted_;
+    const NodeID_* deleted_end_;
+    const Block* block_;
+    int32_t index_;
+
+    void SkipDeleted() {
+      while ((deleted_ != deleted_end_) && (base_ != base_end_)) {
+        NodeID_ v = *base_;
+        while ((deleted_ != deleted_end_) && (*deleted_ < v))
+          ++deleted_;
+        if ((deleted_ == deleted_end_) || (*deleted_ != v))
+          break;
+        ++base_;
+      }
+    }
+
+   public:
+    NeighborIterator(BaseIterator base, BaseIterator base_end,
+                     const NodeID_* deleted, const NodeID_* deleted_end,
+                     const Block* block) :
+        base_(base), base_end_(base_end), deleted_(deleted),
+        deleted_end_(deleted_end), block_(block), index_(0) {
+      SkipDeleted();
+    }
+    NodeID_ operator*() const {
+      return base_ != base_end_ ? *base_ : block_->neighs[index_];
+    }
+    NeighborIterator& operator++() {
+      if (base_ != base_end_) {
+        ++base_;
+        SkipDeleted();
+      } else if (++index_ == block_->size) {
+        block_ = block_->next;
+        index_ = 0;
+      }
+      return *this;
+    }
+    bool operator!=(const NeighborIterator &other) const {
+      return (block_ != other.block_) || (index_ != other.index_) ||
+             (base_ != other.base_);
+    }
+    bool operator==(const NeighborIterator &other) const {
+      return !(*this != other);
+    }
+  };
+
+  class Neighborhood {
+    NeighborIterator begin_;
+    NeighborIterator end_;
+   public:
+    Neighborhood(BaseNeighborhood base, const Tombstones &deleted,
+                 const Block* chain) :
+        begin_(base.begin(), base.end(), deleted.ids,
+               deleted.ids + deleted.size, chain),
+        end_(base.end(), base.end(), nullptr, nullptr, nullptr) {}
+    typedef NeighborIterator iterator;
+    iterator begin() { return begin_; }
+    iterator end()   { return end_; }
+  };
+
+  static int64_t ChainSize(const Block* block) {
+    int64_t size = 0;
+    for (; block != nullptr; block = block->next)
+      size += block->size;
+    return size;
+  }
+
+  static bool Contains(const Tombstones &deleted, NodeID_ v) {
+    return std::binary_search(deleted.ids, deleted.ids + deleted.size, v);
+  }
+
+  // Removes all copies of v from a chain by compacting it in place, blocks
+  // cut off at the end are left unused
+  static int64_t RemoveFromChain(Block* &head, NodeID_ v) {
+    Block* write_block = head;
+    int32_t write_index = 0;
+    int64_t num_removed = 0;
+    for (Block* block = head; block != nullptr; block = block->next) {
+      for (int32_t i=0; i < block->size; i++) {
+        if (block->neighs[i] == v) {
+          num_removed++;
+          continue;
+        }
+        if (write_index == write_block->size) {
+          write_block = write_block->next;
+          write_index = 0;
+        }
+        write_block->neighs[write_index++] = block->neighs[i];
+      }
+    }
+    if (num_removed == 0)
+      return 0;
+    if (write_index == 0) {
+      head = nullptr;
+    } else {
+      write_block->size = write_index;
+      write_block->next = nullptr;
+    }
+    return num_removed;
+  }
+
+  // Sorts records, removes duplicates and self loops like SquishCSR
+  static void Squish(pvector<Edge> &records) {
+    std::sort(records.begin(), records.end());
+    auto new_end = std::unique(records.begin(), records.end());
+    new_end = std::remove_if(records.begin(), new_end,
+                             [](Edge e) { return e.v == e.u; });
+    records.resize(new_end - records.begin());
+  }
+
+  // Records of a batch for the out (or in) direction, squished
+  pvector<Edge> MakeRecords(const pvector<Edge> &batch, bool transpose) const {
+    int64_t n = batch.size();
+    bool symmetric = !directed();
+    pvector<Edge> records(symmetric ? 2 * n : n);
+    #pragma omp parallel for
+    for (int64_t i=0; i < n; i++) {
+      Edge reversed(batch[i].v, batch[i].u);
+      records[i] = transpose ? reversed : batch[i];
+      if (symmetric)
+        records[n + i] = reversed;
+    }
+    Squish(records);
+    return records;
+  }
+
+  // Start of the run of every source in sorted records, then the end
+  static std::vector<int64_t> RunStarts(const pvector<Edge> &records) {
+    std::vector<int64_t> run_starts;
+    for (size_t i=0; i < records.size(); i++) {
+      if ((i == 0) || (records[i].u != records[i-1].u))
+        run_starts.push_back(i);
+    }
+    run_starts.push_back(records.size());
+    return run_starts;
+  }
+
+  // Drops the records turned into self loops
+  static void DropMarked(pvector<Edge> &records) {
+    auto new_end = std::remove_if(records.begin(), records.end(),
+                                  [](Edge e) { return e.v == e.u; });
+    records.resize(new_end - records.begin());
+  }
+
+  // Appends the sorted records to the chains of their sources
+  void Append(const pvector<Edge> &records, pvector<Block*> &chains) {
+    std::vector<int64_t> run_starts = RunStarts(records);
+    int64_t num_runs = run_starts.size() - 1;
+    pvector<int64_t> first_block(num_runs);
+    #pragma omp parallel for
+    for (int64_t r=0; r < num_runs; r++) {
+      const Block* head = chains[records[run_starts[r]].u];
+      int64_t room = head != nullptr ? Block::kCapacity - head->size : 0;
+      int64_t overflow = run_starts[r+1] - run_starts[r] - room;
+      first_block[r] = overflow > 0 ?
+        (overflow + Block::kCapacity - 1) / Block::kCapacity : 0;
+    }
+    int64_t total = 0;
+    for (int64_t r=0; r < num_runs; r++) {
+      int64_t num_blocks = first_block[r];
+      first_block[r] = total;
+      total += num_blocks;
+    }
+    blocks_.emplace_back(total);
+    Block* pool = blocks_.back().data();
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t r=0; r < num_runs; r++) {
+      NodeID_ u = records[run_starts[r]].u;
+      Block* head = chains[u];
+      Block* next_new = pool + first_block[r];
+      for (int64_t i=run_starts[r]; i < run_starts[r+1]; i++) {
+        if ((head == nullptr) || (head->size == Block::kCapacity)) {
+          next_new->next = head;
+          next_new->size = 0;
+          head = next_new++;
+        }
+        head->neighs[head->size++] = records[i].v;
+      }
+      chains[u] = head;
+    }
+  }
+
+  // Removes the tombstones of the run's records by merging the two sorted
+  // sequences, and marks those records so they are not appended
+  static void Revive(Tombstones &deleted, Edge* run, Edge* run_end) {
+    NodeID_ u = run->u;
+    int64_t write = 0;
+    for (int64_t read=0; read < deleted.size; read++) {
+      NodeID_ v = deleted.ids[read];
+      while ((run != run_end) && (run->v < v))
+        ++run;
+      if ((run != run_end) && (run->v == v)) {
+        run->v = u;
+        ++run;
+        continue;
+      }
+      deleted.ids[write++] = v;
+    }
+    deleted.size = write;
+  }
+
+  // Inserts the sorted records into one direction, reviving deleted built
+  // edges instead of appending them
+  void Insert(pvector<Edge> &records, pvector<Block*> &chains,
+              pvector<Tombstones> &deleted) {
+    if (num_deleted_ != 0) {
+      std::vector<int64_t> run_starts = RunStarts(records);
+      int64_t num_runs = run_starts.size() - 1;
+      #pragma omp parallel for schedule(dynamic, 64)
+      for (int64_t r=0; r < num_runs; r++) {
+        NodeID_ u = records[run_starts[r]].u;
+        if (deleted[u].size != 0)
+          Revive(deleted[u], records.begin() + run_starts[r],
+                 records.begin() + run_starts[r+1]);
+      }
+      DropMarked(records);
+    }
+    Append(records, chains);
+  }
+
+  // Merges the sorted records into the tombstones of their sources, arrays
+  // that run out of room move to a new batch pool with double the capacity
+  void AddTombstones(const pvector<Edge> &records,
+                     pvector<Tombstones> &deleted) {
+    std::vector<int64_t> run_starts = RunStarts(records);
+    int64_t num_runs = run_starts.size() - 1;
+    pvector<int64_t> new_offset(num_runs);
+    #pragma omp parallel for
+    for (int64_t r=0; r < num_runs; r++) {
+      const Tombstones &t = deleted[records[run_starts[r]].u];
+      int64_t needed = t.size + run_starts[r+1] - run_starts[r];
+      new_offset[r] = needed > t.capacity ?
+        std::max(needed, 2 * t.capacity) : 0;
+    }
+    int64_t total = 0;
+    for (int64_t r=0; r < num_runs; r++) {
+      int64_t capacity = new_offset[r];
+      new_offset[r] = total;
+      total += capacity;
+    }
+    tombstone_pools_.emplace_back(total);
+    NodeID_* pool = tombstone_pools_.back().data();
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t r=0; r < num_runs; r++) {
+      Tombstones &t = deleted[records[run_starts[r]].u];
+      int64_t num_new = run_starts[r+1] - run_starts[r];
+      NodeID_* dest = t.ids;
+      if (t.size + num_new > t.capacity) {
+        dest = pool + new_offset[r];
+        t.capacity = std::max(t.size + num_new, 2 * t.capacity);
+      }
+      // merges from the back, so it also works in place
+      int64_t i = t.size - 1;
+      int64_t j = run_starts[r+1] - 1;
+      for (int64_t k = t.size + num_new - 1; k >= 0; k--) {
+        if ((j < run_starts[r]) || ((i >= 0) && (t.ids[i] > records[j].v)))
+          dest[k] = t.ids[i--];
+        else
+          dest[k] = records[j--].v;
+      }
+      t.ids = dest;
+      t.size += num_new;
+    }
+  }
+
+  // Deletes the sorted records from one direction, returns how many
+  // neighbors (with copies) were removed
+  int64_t Delete(pvector<Edge> &records, pvector<Block*> &chains,
+                 pvector<Tombstones> &deleted, bool transpose) {
+    std::vector<int64_t> run_starts = RunStarts(records);
+    int64_t num_runs = run_starts.size() - 1;
+    int64_t num_removed = 0;
+    #pragma omp parallel for schedule(dynamic, 64) reduction(+ : num_removed)
+    for (int64_t r=0; r < num_runs; r++) {
+      NodeID_ u = records[run_starts[r]].u;
+      for (int64_t i=run_starts[r]; i < run_starts[r+1]; i++) {
+        NodeID_ v = records[i].v;
+        num_removed += RemoveFromChain(chains[u], v);
+        if (!Contains(deleted[u], v) && BaseContains(u, v, transpose))
+          num_removed++;
+        else
+          records[i].v = u;
+      }
+    }
+    DropMarked(records);
+    AddTombstones(records, deleted);
+    return num_removed;
+  }
+
+  // Built neighborhoods are sorted, compressed ones can only be decoded in
+  // order so their scan stops at the first neighbor not smaller than v
+  bool BaseContains(NodeID_ u, NodeID_ v, bool transpose) const {
+    BaseNeighborhood neighs = transpose ? base_.in_neigh(u) :
+                                          base_.out_neigh(u);
+    if constexpr (std::is_pointer<BaseIterator>::value) {
+      return std::binary_search(neighs.begin(), neighs.end(), v);
+    } else {
+      for (NodeID_ w : neighs) {
+        if (w >= v)
+          return w == v;
+      }
+      return false;
+    }
+  }
+
+ public:
+  explicit DynamicGraph(BaseGraph_ &&base) :
+      base_(std::move(base)), out_chains_(base_.num_nodes(), nullptr),
+      out_deleted_(base_.num_nodes(), Tombstones{nullptr, 0, 0}),
+      num_inserted_(0), num_deleted_(0) {
+    if (base_.directed()) {
+      in_chains_ = pvector<Block*>(base_.num_nodes(), nullptr);
+      in_deleted_ = pvector<Tombstones>(base_.num_nodes(),
+                                        Tombstones{nullptr, 0, 0});
+    }
+  }
+
+  // Inserts a batch of edges, returns how many were new to the batch
+  int64_t InsertEdges(const pvector<Edge> &batch) {
+    pvector<Edge> out_records = MakeRecords(batch, false);
+    int64_t num_inserted = out_records.size();
+    Insert(out_records, out_chains_, out_deleted_);
+    if (directed()) {
+      pvector<Edge> in_records = MakeRecords(batch, true);
+      Insert(in_records, in_chains_, in_deleted_);
+    } else {
+      num_inserted /= 2;
+    }
+    num_inserted_ += num_inserted;
+    return num_inserted;
+  }
+
+  // Deletes a batch of edges, returns how many were in the graph (with copies)
+  int64_t DeleteEdges(const pvector<Edge> &batch) {
+    pvector<Edge> out_records = MakeRecords(batch, false);
+    int64_t num_deleted = Delete(out_records, out_chains_, out_deleted_,
+                                 false);
+    if (directed()) {
+      pvector<Edge> in_records = MakeRecords(batch, true);
+      Delete(in_records, in_chains_, in_deleted_, true);
+    } else {
+      num_deleted /= 2;
+    }
+    num_deleted_ += num_deleted;
+    return num_deleted;
+  }
+
+  bool directed() const {
+    return base_.directed();
+  }
+
+  int64_t num_nodes() const {
+    return base_.num_nodes();
+  }
+
+  int64_t num_edges() const {
+    return base_.num_edges() + num_inserted_ - num_deleted_;
+  }
+
+  int64_t num_edges_directed() const {
+    return directed() ? num_edges() : 2*num_edges();
+  }
+
+  int64_t out_degree(NodeID_ v) const {
+    return base_.out_degree(v) - out_deleted_[v].size +
+           ChainSize(out_chains_[v]);
+  }
+
+  int64_t in_degree(NodeID_ v) const {
+    if (!directed())
+      return out_degree(v);
+    return base_.in_degree(v) - in_deleted_[v].size +
+           ChainSize(in_chains_[v]);
+  }
+
+  Neighborhood out_neigh(NodeID_ n) const {
+    return Neighborhood(base_.out_neigh(n), out_deleted_[n], out_chains_[n]);
+  }
+
+  Neighborhood in_neigh(NodeID_ n) const {
+    if (!directed())
+      return out_neigh(n);
+    return Neighborhood(base_.in_neigh(n), in_deleted_[n], in_chains_[n]);
+  }
+
+  void PrintStats() const {
+    PrintAligned("Nodes", num_nodes());
+    PrintAligned("Edges", num_edges());
+    PrintLabel("Directed", directed() ? "Yes" : "No");
+    PrintAligned("Degree", num_edges()/num_nodes());
+    PrintMaxDegree();
+    PrintAligned("Inserted Edges", num_inserted_);
+    PrintAligned("Deleted Edges", num_deleted_);
+  }
+
+  void PrintMaxDegree() const {
+    int64_t max_degree = 0;
+    #pragma omp parallel for reduction(max : max_degree)
+    for (NodeID_ n=0; n < num_nodes(); n++)
+      max_degree = std::max(max_degree, out_degree(n));
+    PrintAligned("Max Degree", max_degree);
+  }
+
+  Range<NodeID_> vertices() const {
+    return Range<NodeID_>(num_nodes());
+  }
+
+ private:
+  BaseGraph_ base_;
+  pvector<Block*> out_chains_;
+  pvector<Tombstones> out_deleted_;
+  pvector<Block*> in_chains_;
+  pvector<Tombstones> in_deleted_;
+  std::vector<pvector<Block>> blocks_;
+  std::vector<pvector<NodeID_>> tombstone_pools_;
+  int64_t num_inserted_;
+  int64_t num_deleted_;
+};
+
+#endif  // DYNAMIC_GRAPH_H_
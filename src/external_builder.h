@@ -0,0 +1,326 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef EXTERNAL_BUILDER_H_
+#define EXTERNAL_BUILDER_H_
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "command_line.h"
+#include "generator.h"
+#include "graph.h"
+#include "mapped_file.h"
+#include "pvector.h"
+#include "reader.h"
+#include "timer.h"
+#include "util.h"
+
+
+/*
+GAP Benchmark Suite
+Class:  ExternalBuilder
+
+Builds a serialized graph (.sg or .wsg) from an edge list that does not fit
+into memory together with the graph (converter -X budget)
+ - Reads the edge list in chunks sized to the memory budget and turns every
+   chunk into a sorted and squished run per direction in a scratch directory
+ - Merges the runs of a direction straight into the output file, removing
+   duplicates across runs; offsets and neighbors are written sequentially at
+   their final positions, so no array of the graph is ever held in memory
+ - Symmetrizes, weighs and squishes like BuilderBase, so the output is
+   byte-identical to building in memory and writing with WriterBase (v2,
+   checksums are summed while streaming)
+*/
+
+
+template <typename NodeID_, typename DestID_ = NodeID_,
+          typename WeightT_ = NodeID_>
+class ExternalBuilder {
+  typedef EdgePair<NodeID_, DestID_> Edge;
+  typedef pvector<Edge> EdgeList;
+
+  // Sequential writer at a fixed position of a file
+  class BufferedWriter {
+   public:
+    BufferedWriter(int fd, off_t pos, size_t buffer_bytes) :
+      fd_(fd), pos_(pos), buffer_(buffer_bytes), used_(0) {}
+
+    ~BufferedWriter() { Flush(); }
+
+    template <typename T_>
+    void Write(const T_ &value) {
+      if (used_ + sizeof(T_) > buffer_.size())
+        Flush();
+      std::memcpy(buffer_.data() + used_, &value, sizeof(T_));
+      used_ += sizeof(T_);
+    }
+
+    void Flush() {
+      if (!ParallelPositionalIO(fd_, buffer_.data(), used_, pos_, true)) {
+        std::cout << "Couldn't write graph" << std::endl;
+        std::exit(-5);
+      }
+      checksum_.Update(buffer_.data(), used_);
+      pos_ += used_;
+      used_ = 0;
+    }
+
+    // Of everything flushed so far
+    uint64_t checksum() const { return checksum_.value(); }
+
+   private:
+    int fd_;
+    off_t pos_;
+    std::vector<char> buffer_;
+    size_t used_;
+    SGChecksum checksum_;
+  };
+
+  // Reads a sorted run back in buffered pieces
+  class RunReader {
+   public:
+    RunReader(std::string filename, size_t buffer_edges) :
+        filename_(filename), buffer_(buffer_edges), next_(0), size_(0),
+        pos_(0) {
+      fd_ = open(filename.c_str(), O_RDONLY);
+      if (fd_ == -1) {
+        std::cout << "Couldn't open run " << filename << std::endl;
+        std::exit(-6);
+      }
+    }
+
+    ~RunReader() {
+      close(fd_);
+      unlink(filename_.c_str());
+    }
+
+    bool Next(Edge &e) {
+      if (next_ == size_) {
+        ssize_t bytes = pread(fd_, buffer_.data(),
+                              buffer_.size() * sizeof(Edge), pos_);
+        if (bytes <= 0)
+          return false;
+        pos_ += bytes;
+        size_ = bytes / sizeof(Edge);
+        next_ = 0;
+      }
+      e = buffer_[next_++];
+      return true;
+    }
+
+   private:
+    std::string filename_;
+    int fd_;
+    std::vector<Edge> buffer_;
+    size_t next_, size_;
+    off_t pos_;
+  };
+
+ public:
+  explicit ExternalBuilder(const CLConvert &cli) : cli_(cli) {
+    symmetrize_ = cli_.symmetrize();
+    needs_weights_ = !std::is_same<NodeID_, DestID_>::value;
+    budget_bytes_ = cli_.memory_budget() << 20;
+    scratch_dir_ = cli_.scratch_dir();
+    if (scratch_dir_ == "") {
+      size_t slash = cli_.out_filename().rfind('/');
+      scratch_dir_ = slash == std::string::npos ? "." :
+                     cli_.out_filename().substr(0, slash);
+    }
+    if (cli_.filename() == "") {
+      std::cout << "Out-of-core building needs an edge list file (-f)"
+                << std::endl;
+      std::exit(-36);
+    }
+    if (cli_.relabel() != RelabelStrategy::NONE) {
+      std::cout << "Out-of-core building does not relabel (-R)" << std::endl;
+      std::exit(-36);
+    }
+  }
+
+  void WriteSerializedGraph(std::string filename) {
+    if (!std::is_same<NodeID_, SGID>::value) {
+      std::cout << "serialized graphs only allowed for 32b IDs" << std::endl;
+      std::exit(-4);
+    }
+    Timer t;
+    t.Start();
+    MakeRuns();
+    t.Stop();
+    PrintAligned("Runs", out_runs_.size());
+    PrintTime("Run Time", t.Seconds());
+    t.Start();
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+      std::cout << "Couldn't write to file " << filename << std::endl;
+      std::exit(-5);
+    }
+    // The layout up to the out neighbors doesn't depend on num_edges
+    bool directed = !symmetrize_;
+    SGHeader header = MakeSGHeader(directed, num_nodes_, 0, sizeof(NodeID_),
+                                   sizeof(DestID_));
+    uint64_t checksums[kSGMaxSections];
+    SGOffset num_edges = Merge(out_runs_, fd, header.sections[0].start,
+                               header.sections[1].start, checksums);
+    header = MakeSGHeader(directed, num_nodes_, num_edges, sizeof(NodeID_),
+                          sizeof(DestID_));
+    if (directed)
+      Merge(in_runs_, fd, header.sections[2].start, header.sections[3].start,
+            checksums + 2);
+    for (uint32_t s=0; s < header.num_sections; s++)
+      header.sections[s].checksum = checksums[s];
+    if ((ftruncate(fd, SGFileBytes(header)) != 0) ||
+        (pwrite(fd, &header, sizeof(SGHeader), 0) != sizeof(SGHeader))) {
+      std::cout << "Couldn't write to file " << filename << std::endl;
+      std::exit(-5);
+    }
+    close(fd);
+    t.Stop();
+    PrintTime("Merge Time", t.Seconds());
+    PrintAligned("Nodes", num_nodes_);
+    printf("%-21s%" PRId64 "\n", "Edges Written:", num_edges);
+  }
+
+ private:
+  static DestID_ Reversed(const Edge &e) {
+    if constexpr (std::is_same<NodeID_, DestID_>::value)
+      return e.u;
+    else
+      return DestID_(e.u, e.v.w);
+  }
+
+  // Sorts, removes duplicates and self loops like SquishCSR, then spills
+  void WriteRun(EdgeList &records, std::vector<std::string> &runs) {
+    std::sort(records.begin(), records.end());
+    auto new_end = std::unique(records.begin(), records.end());
+    new_end = std::remove_if(records.begin(), new_end,
+                             [](Edge e) { return e.v == e.u; });
+    std::string filename = scratch_dir_ + "/.gap_run_" +
+                           std::to_string(getpid()) + "_" +
+                           std::to_string(num_runs_++);
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    size_t num_bytes = (new_end - records.begin()) * sizeof(Edge);
+    if ((fd == -1) ||
+        !ParallelPositionalIO(fd, reinterpret_cast<char*>(records.data()),
+                              num_bytes, 0, true)) {
+      std::cout << "Couldn't write run " << filename << std::endl;
+      std::exit(-5);
+    }
+    close(fd);
+    runs.push_back(filename);
+  }
+
+  void MakeRuns() {
+    // Input chunk plus two records per edge, with slack for parsing
+    int64_t max_edges = std::max<int64_t>(
+      1 << 16, budget_bytes_ / (4 * sizeof(Edge)));
+    Reader<NodeID_, DestID_, WeightT_> r(cli_.filename());
+    int64_t edges_seen = 0;
+    NodeID_ max_seen = 0;
+    r.StreamFile(max_edges, needs_weights_, [&](EdgeList &chunk) {
+      #pragma omp parallel for reduction(max : max_seen)
+      for (auto it = chunk.begin(); it < chunk.end(); it++) {
+        max_seen = std::max(max_seen, it->u);
+        max_seen = std::max(max_seen, static_cast<NodeID_>(it->v));
+      }
+      if (needs_weights_)
+        Generator<NodeID_, DestID_, WeightT_>::InsertWeights(chunk,
+                                                             edges_seen);
+      edges_seen += chunk.size();
+      int64_t n = chunk.size();
+      {
+        EdgeList out_records(symmetrize_ ? 2 * n : n);
+        #pragma omp parallel for
+        for (int64_t i=0; i < n; i++) {
+          out_records[i] = chunk[i];
+          if (symmetrize_)
+            out_records[n + i] = Edge(chunk[i].v, Reversed(chunk[i]));
+        }
+        WriteRun(out_records, out_runs_);
+      }
+      if (!symmetrize_) {
+        EdgeList in_records(n);
+        #pragma omp parallel for
+        for (int64_t i=0; i < n; i++)
+          in_records[i] = Edge(chunk[i].v, Reversed(chunk[i]));
+        WriteRun(in_records, in_runs_);
+      }
+    });
+    num_nodes_ = r.num_nodes() != -1 ? r.num_nodes() : max_seen + 1;
+  }
+
+  // k-way merge of runs into offsets at index_pos and neighbors at neigh_pos,
+  // returns the number of neighbors and both sections' checksums
+  SGOffset Merge(std::vector<std::string> &runs, int fd, off_t index_pos,
+                 off_t neigh_pos, uint64_t* checksums) {
+    size_t buffer_edges = std::max<size_t>(
+      1 << 12, budget_bytes_ / ((runs.size() + 2) * sizeof(Edge)));
+    std::vector<RunReader*> readers;
+    for (std::string run : runs)
+      readers.push_back(new RunReader(run, buffer_edges));
+    typedef std::pair<Edge, size_t> HeadT;
+    auto later = [](const HeadT &a, const HeadT &b) {
+      return (b.first < a.first) ||
+             (!(a.first < b.first) && (b.second < a.second));
+    };
+    std::priority_queue<HeadT, std::vector<HeadT>, decltype(later)>
+      heads(later);
+    Edge e;
+    for (size_t r=0; r < readers.size(); r++) {
+      if (readers[r]->Next(e))
+        heads.push(std::make_pair(e, r));
+    }
+    BufferedWriter index_out(fd, index_pos, buffer_edges * sizeof(Edge));
+    BufferedWriter neigh_out(fd, neigh_pos, buffer_edges * sizeof(Edge));
+    SGOffset num_written = 0;
+    int64_t next_node = 0;
+    Edge last;
+    while (!heads.empty()) {
+      HeadT head = heads.top();
+      heads.pop();
+      if (readers[head.second]->Next(e))
+        heads.push(std::make_pair(e, head.second));
+      // sorted by weight too, so the first copy has the smallest weight
+      if ((num_written != 0) && (head.first == last))
+        continue;
+      for (; next_node <= head.first.u; next_node++)
+        index_out.Write(num_written);
+      neigh_out.Write(head.first.v);
+      num_written++;
+      last = head.first;
+    }
+    for (; next_node <= num_nodes_; next_node++)
+      index_out.Write(num_written);
+    index_out.Flush();
+    neigh_out.Flush();
+    checksums[0] = index_out.checksum();
+    checksums[1] = neigh_out.checksum();
+    for (RunReader* reader : readers)
+      delete reader;
+    runs.clear();
+    return num_written;
+  }
+
+  const CLConvert &cli_;
+  bool symmetrize_;
+  bool needs_weights_;
+  int64_t budget_bytes_;
+  std::string scratch_dir_;
+  int64_t num_nodes_ = -1;
+  int64_t num_runs_ = 0;
+  std::vector<std::string> out_runs_;
+  std::vector<std::string> in_runs_;
+};
+
+#endif  // EXTERNAL_BUILDER_H_
@@ -11,6 +11,7 @@
 #include <random>
 #include <math.h>
 #include <queue>
+#include <vector>
 
 #include "graph.h"
 #include "pvector.h"
@@ -26,6 +27,8 @@ Author: Scott Beamer
 Given scale and degree, generates edgelist for synthetic graph
  - Intended to be called from Builder
  - GenerateEL(uniform) generates and returns the edgelist
+ - VisitEdges(uniform) regenerates the edges of uniform or R-MAT graphs
+   on demand instead (e.g., to build a CSR directly)
  - Can generate uniform random (uniform=true) or R-MAT graph according
    to Graph500 parameters (uniform=false)
  - Can also randomize weights within a weighted edgelist (InsertWeights)
@@ -33,6 +36,10 @@ Given scale and degree, generates edgelist for synthetic graph
 */
 
 
+// Bump whenever the generated graphs change, invalidates cached graphs (-C)
+static const int kGeneratorVersion = 1;
+
+
 // maps to range [0,max_value], tailored to STL-style RNG
 template <typename NodeID_, typename rng_t_,
           typename uNodeID_ = typename std::make_unsigned<NodeID_>::type>
@@ -94,32 +101,94 @@ class Generator {
     }
   }
 
-  void PermuteIDs(EdgeList &el) {
+  int64_t num_nodes() const { return num_nodes_; }
+
+  pvector<NodeID_> MakePermutation() {
     pvector<NodeID_> permutation(num_nodes_);
     rng_t_ rng(kRandSeed);
     #pragma omp parallel for
     for (NodeID_ n=0; n < num_nodes_; n++)
       permutation[n] = n;
     shuffle(permutation.begin(), permutation.end(), rng);
+    return permutation;
+  }
+
+  void PermuteIDs(EdgeList &el) {
+    pvector<NodeID_> permutation = MakePermutation();
     #pragma omp parallel for
     for (int64_t e=0; e < num_edges_; e++)
       el[e] = Edge(permutation[el[e].u], permutation[el[e].v]);
   }
 
-  EdgeList MakeUniformEL() {
-    EdgeList el(num_edges_);
+  /*
+  Calls visit(e, edge) in parallel for every edge e of a uniform
+  (uniform=true) or Kronecker graph without materializing the edge list
+    - Each block of edges is regenerated from its own seed, so every call
+      visits the same edges as MakeUniformEL/MakeRMatEL return
+    - With insert_weights, edges carry the weights InsertWeights would give
+  */
+  template <typename VisitFunc>
+  void VisitEdges(bool uniform, bool insert_weights, VisitFunc visit) {
+    const uint32_t max = std::numeric_limits<uint32_t>::max();
+    const uint32_t A = 0.57*max, B = 0.19*max, C = 0.19*max;
+    if (!uniform && (permutation_.size() == 0))
+      permutation_ = MakePermutation();
     #pragma omp parallel
     {
-      rng_t_ rng;
+      rng_t_ rng, weight_rng;
+      std::mt19937 rmat_rng;
       UniDist<NodeID_, rng_t_> udist(num_nodes_-1, rng);
+      UniDist<WeightT_, rng_t_> wdist(254, weight_rng);
+      // visits in batches, keeps generation apart from the visitor's work
+      const int64_t kBatchSize = 1 << 12;
+      std::vector<Edge> batch(kBatchSize);
       #pragma omp for
       for (int64_t block=0; block < num_edges_; block+=block_size) {
-        rng.seed(kRandSeed + block/block_size);
-        for (int64_t e=block; e < std::min(block+block_size, num_edges_); e++) {
-          el[e] = Edge(udist(), udist());
+        if (uniform)
+          rng.seed(kRandSeed + block/block_size);
+        else
+          rmat_rng.seed(kRandSeed + block/block_size);
+        if (insert_weights)
+          weight_rng.seed(kRandSeed + block/block_size);
+        int64_t block_end = std::min(block+block_size, num_edges_);
+        for (int64_t first=block; first < block_end; first+=kBatchSize) {
+          int64_t batch_end = std::min(first+kBatchSize, block_end);
+          for (int64_t e=first; e < batch_end; e++) {
+            Edge &edge = batch[e - first];
+            if (uniform) {
+              edge = Edge(udist(), udist());
+            } else {
+              NodeID_ src = 0, dst = 0;
+              for (int depth=0; depth < scale_; depth++) {
+                uint32_t rand_point = rmat_rng();
+                src = src << 1;
+                dst = dst << 1;
+                if (rand_point < A+B) {
+                  if (rand_point > A)
+                    dst++;
+                } else {
+                  src++;
+                  if (rand_point > A+B+C)
+                    dst++;
+                }
+              }
+              edge = Edge(permutation_[src], permutation_[dst]);
+            }
+            if (insert_weights)
+              SetWeight(edge.v, static_cast<WeightT_>(wdist()+1));
+          }
+          for (int64_t e=first; e < batch_end; e++)
+            visit(e, batch[e - first]);
         }
       }
     }
+  }
+
+  EdgeList MakeUniformEL() {
+    EdgeList el(num_edges_);
+    VisitEdges(true, false, [&](int64_t e, const Edge &edge) {
+      el[e] = edge;
+    });
     return el;
   }
 
@@ -221,35 +290,10 @@ class Generator {
   }
 
   EdgeList MakeRMatEL() {
-    const uint32_t max = std::numeric_limits<uint32_t>::max();
-    const uint32_t A = 0.57*max, B = 0.19*max, C = 0.19*max;
     EdgeList el(num_edges_);
-    #pragma omp parallel
-    {
-      std::mt19937 rng;
-      #pragma omp for
-      for (int64_t block=0; block < num_edges_; block+=block_size) {
-        rng.seed(kRandSeed + block/block_size);
-        for (int64_t e=block; e < std::min(block+block_size, num_edges_); e++) {
-          NodeID_ src = 0, dst = 0;
-          for (int depth=0; depth < scale_; depth++) {
-            uint32_t rand_point = rng();
-            src = src << 1;
-            dst = dst << 1;
-            if (rand_point < A+B) {
-              if (rand_point > A)
-                dst++;
-            } else {
-              src++;
-              if (rand_point > A+B+C)
-                dst++;
-            }
-          }
-          el[e] = Edge(src, dst);
-        }
-      }
-    }
-    PermuteIDs(el);
+    VisitEdges(false, false, [&](int64_t e, const Edge &edge) {
+      el[e] = edge;
+    });
     // TIME_PRINT("Shuffle", std::shuffle(el.begin(), el.end(),
     //                                    std::mt19937()));
     return el;
@@ -288,30 +332,44 @@ class Generator {
     return el;
   }
 
-  static void InsertWeights(pvector<EdgePair<NodeID_, NodeID_>> &el) {}
+  static void InsertWeights(pvector<EdgePair<NodeID_, NodeID_>> &el,
+                            int64_t first_edge = 0) {}
 
   // Overwrites existing weights with random from [1,255]
-  static void InsertWeights(pvector<WEdge> &el) {
+  //  - el can be a part of a larger edge list starting at first_edge, the
+  //    weights are the same as if the whole edge list was processed
+  static void InsertWeights(pvector<WEdge> &el, int64_t first_edge = 0) {
     #pragma omp parallel
     {
       rng_t_ rng;
       UniDist<WeightT_, rng_t_> udist(254, rng);
-      int64_t el_size = el.size();
+      int64_t el_end = first_edge + el.size();
+      int64_t first_block = first_edge - first_edge % block_size;
       #pragma omp for
-      for (int64_t block=0; block < el_size; block+=block_size) {
+      for (int64_t block=first_block; block < el_end; block+=block_size) {
         rng.seed(kRandSeed + block/block_size);
-        for (int64_t e=block; e < std::min(block+block_size, el_size); e++) {
-          el[e].v.w = static_cast<WeightT_>(udist()+1);
+        for (int64_t e=block; e < std::min(block+block_size, el_end); e++) {
+          WeightT_ w = static_cast<WeightT_>(udist()+1);
+          if (e >= first_edge)
+            el[e - first_edge].v.w = w;
         }
       }
     }
   }
 
  private:
+  static void SetWeight(NodeID_ &v, WeightT_ w) {}
+
+  template <typename W_>
+  static void SetWeight(NodeWeight<NodeID_, W_> &v, WeightT_ w) {
+    v.w = w;
+  }
+
   int scale_;
   int64_t num_nodes_;
   int64_t num_edges_;
   int64_t degree_;
+  pvector<NodeID_> permutation_;
   static const int64_t block_size = 1<<18;
 };
 
@@ -7,9 +7,13 @@
 #include <algorithm>
 #include <cinttypes>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <type_traits>
 
+#include "mapped_file.h"
 #include "pvector.h"
 #include "util.h"
 
@@ -23,6 +27,9 @@ Simple container for graph in CSR format
  - Intended to be constructed by a Builder
  - To make weighted, set DestID_ template type to NodeWeight
  - MakeInverse parameter controls whether graph stores incoming edges
+ - Neighborhoods are found through an offset array (CSROffsets) per direction
+ - Offset and neighbor arrays may live inside a MappedFile (zero-copy load),
+   which the graph then keeps alive instead of freeing them
 */
 
 
@@ -93,6 +100,218 @@ typedef int32_t SGID;
 typedef EdgePair<SGID> SGEdge;
 typedef int64_t SGOffset;
 
+// Flags of a serialized graph, in v1 (headerless) files they are the first
+// byte, where graphs with 32-bit IDs only ever set kSGDirected, so the byte
+// reads the same as the original bool
+const uint8_t kSGDirected = 1;
+const uint8_t kSGWideIDs = 2;   // 64-bit IDs, written by NODEID=64 builds
+
+// Serialized graph v2 (.sg, .wsg), SGHeader followed by its sections
+//  - Sections are out offsets, out neighbors and if directed in offsets and
+//    in neighbors, each starting kSGAlign-aligned so a mapped file is used
+//    in place (unused sections are empty)
+//  - v1 files (flags, num_edges, num_nodes, then the same arrays unaligned)
+//    are told apart by the magic, since their first byte is at most 3
+const int kSGMaxSections = 4;
+const int64_t kSGAlign = 4096;
+const uint32_t kSGVersion = 2;
+static const char kSGMagic[8] = {'G', 'A', 'P', 'B', 'S', 'G', '\0', '\0'};
+
+struct SGSection {
+  int64_t start;        // bytes from the start of the file
+  int64_t num_bytes;
+  uint64_t checksum;    // SGChecksum of the section
+};
+
+struct SGHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t offset_bytes;
+  uint32_t id_bytes;
+  uint32_t dest_bytes;  // bytes per neighbor (with weight)
+  uint32_t flags;
+  uint32_t num_sections;
+  int64_t num_nodes;
+  int64_t num_edges;    // per direction, as in v1
+  SGSection sections[kSGMaxSections];
+};
+
+// Lays out a v2 serialized graph, checksums are left to the writer
+inline SGHeader MakeSGHeader(bool directed, int64_t num_nodes,
+                             int64_t num_edges, uint32_t id_bytes,
+                             uint32_t dest_bytes) {
+  SGHeader header = {};
+  std::copy(kSGMagic, kSGMagic + sizeof(kSGMagic), header.magic);
+  header.version = kSGVersion;
+  header.offset_bytes = sizeof(SGOffset);
+  header.id_bytes = id_bytes;
+  header.dest_bytes = dest_bytes;
+  header.flags = (directed ? kSGDirected : 0) |
+                 (id_bytes > sizeof(SGID) ? kSGWideIDs : 0);
+  header.num_sections = directed ? 4 : 2;
+  header.num_nodes = num_nodes;
+  header.num_edges = num_edges;
+  int64_t pos = sizeof(SGHeader);
+  for (uint32_t s=0; s < header.num_sections; s++) {
+    pos = (pos + kSGAlign - 1) / kSGAlign * kSGAlign;
+    header.sections[s].start = pos;
+    header.sections[s].num_bytes = s % 2 == 0 ?
+        (num_nodes + 1) * sizeof(SGOffset) : num_edges * dest_bytes;
+    pos += header.sections[s].num_bytes;
+  }
+  return header;
+}
+
+// Bytes of the whole file described by header
+inline int64_t SGFileBytes(const SGHeader &header) {
+  int64_t num_bytes = sizeof(SGHeader);
+  for (uint32_t s=0; s < header.num_sections; s++)
+    num_bytes = std::max(num_bytes, header.sections[s].start +
+                                    header.sections[s].num_bytes);
+  return num_bytes;
+}
+
+// Checksum of a section, the sum over its 8-byte words (the last one padded
+// with zeros) of each word mixed with its index, so pieces can be summed
+// independently: in parallel by Update, or while streaming by many Updates
+class SGChecksum {
+ public:
+  SGChecksum() : sum_(0), num_words_(0), partial_(0), partial_bytes_(0) {}
+
+  void Update(const void* data, size_t num_bytes) {
+    const char* bytes = static_cast<const char*>(data);
+    for (; (partial_bytes_ != 0) && (num_bytes != 0); num_bytes--)
+      AddByte(*bytes++);
+    int64_t full_words = num_bytes / sizeof(uint64_t);
+    uint64_t sum = 0;
+    #pragma omp parallel for reduction(+ : sum) schedule(static, 1 << 16)
+    for (int64_t i=0; i < full_words; i++) {
+      uint64_t word;
+      std::memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+      sum += Mix(word, num_words_ + i);
+    }
+    sum_ += sum;
+    num_words_ += full_words;
+    bytes += full_words * sizeof(uint64_t);
+    num_bytes -= full_words * sizeof(uint64_t);
+    for (; num_bytes != 0; num_bytes--)
+      AddByte(*bytes++);
+  }
+
+  uint64_t value() const {
+    return partial_bytes_ == 0 ? sum_ : sum_ + Mix(partial_, num_words_);
+  }
+
+  static uint64_t Of(const void* data, size_t num_bytes) {
+    SGChecksum checksum;
+    checksum.Update(data, num_bytes);
+    return checksum.value();
+  }
+
+ private:
+  // splitmix64 finalizer, a bijection, so changing any word changes the sum
+  static uint64_t Mix(uint64_t word, uint64_t index) {
+    uint64_t z = word ^ (index * 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  void AddByte(char byte) {
+    partial_ |= static_cast<uint64_t>(static_cast<uint8_t>(byte))
+                << (8 * partial_bytes_);
+    if (++partial_bytes_ == sizeof(uint64_t)) {
+      sum_ += Mix(partial_, num_words_++);
+      partial_ = 0;
+      partial_bytes_ = 0;
+    }
+  }
+
+  uint64_t sum_;
+  uint64_t num_words_;
+  uint64_t partial_;
+  size_t partial_bytes_;
+};
+
+// BEL = binary edge list (.bel, .wbel), header followed by packed EdgePairs
+//  - num_nodes is -1 if it should be derived from the largest ID
+struct BELHeader {
+  char magic[8];
+  uint32_t id_bytes;
+  uint32_t dest_bytes;
+  int64_t num_nodes;
+  int64_t num_edges;
+};
+static const char kBELMagic[8] = {'G', 'A', 'P', 'B', 'E', 'L', '1', '\0'};
+
+
+// Start of each vertex's neighborhood within a neighbor array (n+1 entries)
+//  - Stored with 32 bits when all offsets fit, with 64 bits (SGOffset) otherwise
+//  - Only a view, storage is managed by CSRGraph (and may be mapped)
+class CSROffsets {
+ public:
+  CSROffsets() : wide_(nullptr), narrow_(nullptr) {}
+
+  explicit CSROffsets(const SGOffset* wide) :
+    wide_(const_cast<SGOffset*>(wide)), narrow_(nullptr) {}
+
+  explicit CSROffsets(uint32_t* narrow) : wide_(nullptr), narrow_(narrow) {}
+
+  // Copies offsets, narrowing them if possible
+  static CSROffsets Copy(const pvector<SGOffset> &offsets) {
+    if (Fits32(offsets))
+      return Narrow(offsets);
+    SGOffset* wide = AllocateArray<SGOffset>(offsets.size());
+    #pragma omp parallel for
+    for (size_t n=0; n < offsets.size(); n++)
+      wide[n] = offsets[n];
+    return CSROffsets(wide);
+  }
+
+  // Same as Copy, but takes over the storage of offsets if they stay wide
+  static CSROffsets Adopt(pvector<SGOffset> &&offsets) {
+    if (Fits32(offsets))
+      return Narrow(offsets);
+    CSROffsets adopted(offsets.data());
+    offsets.leak();
+    return adopted;
+  }
+
+  SGOffset operator[](int64_t n) const {
+    return narrow_ != nullptr ? narrow_[n] : wide_[n];
+  }
+
+  bool narrow() const { return narrow_ != nullptr; }
+  bool empty() const { return (wide_ == nullptr) && (narrow_ == nullptr); }
+
+  const void* data() const {
+    return narrow_ != nullptr ? static_cast<const void*>(narrow_) : wide_;
+  }
+
+  void Delete() {
+    FreeArray(wide_);
+    FreeArray(narrow_);
+    wide_ = nullptr;
+    narrow_ = nullptr;
+  }
+
+ private:
+  static bool Fits32(const pvector<SGOffset> &offsets) {
+    return offsets.size() != 0 && offsets[offsets.size()-1] <= UINT32_MAX;
+  }
+
+  static CSROffsets Narrow(const pvector<SGOffset> &offsets) {
+    uint32_t* narrow = AllocateArray<uint32_t>(offsets.size());
+    #pragma omp parallel for
+    for (size_t n=0; n < offsets.size(); n++)
+      narrow[n] = offsets[n];
+    return CSROffsets(narrow);
+  }
+
+  SGOffset* wide_;
+  uint32_t* narrow_;
+};
+
 
 
 template <class NodeID_, class DestID_ = NodeID_, bool MakeInverse = true>
@@ -102,63 +321,67 @@ class CSRGraph {
 
   // Used to access neighbors of vertex, basically sugar for iterators
   class Neighborhood {
-    NodeID_ n_;
-    DestID_** g_index_;
-    OffsetT start_offset_;
+    DestID_* begin_;
+    DestID_* end_;
    public:
-    Neighborhood(NodeID_ n, DestID_** g_index, OffsetT start_offset) :
-        n_(n), g_index_(g_index), start_offset_(0) {
-      OffsetT max_offset = end() - begin();
-      start_offset_ = std::min(start_offset, max_offset);
-    }
+    Neighborhood(DestID_* begin, DestID_* end, OffsetT start_offset) :
+        begin_(begin + std::min(start_offset, OffsetT(end - begin))),
+        end_(end) {}
     typedef DestID_* iterator;
-    iterator begin() { return g_index_[n_] + start_offset_; }
-    iterator end()   { return g_index_[n_+1]; }
+    iterator begin() { return begin_; }
+    iterator end()   { return end_; }
   };
 
+  bool Owns(const void* storage) const {
+    return (storage != nullptr) && !(mapping_ && mapping_->contains(storage));
+  }
+
   void ReleaseResources() {
-    if (out_index_ != nullptr)
-      delete[] out_index_;
-    if (out_neighbors_ != nullptr)
-      delete[] out_neighbors_;
+    if (Owns(out_offsets_.data()))
+      out_offsets_.Delete();
+    if (Owns(out_neighbors_))
+      FreeArray(out_neighbors_);
     if (directed_) {
-      if (in_index_ != nullptr)
-        delete[] in_index_;
-      if (in_neighbors_ != nullptr)
-        delete[] in_neighbors_;
+      if (Owns(in_offsets_.data()))
+        in_offsets_.Delete();
+      if (Owns(in_neighbors_))
+        FreeArray(in_neighbors_);
     }
+    mapping_.reset();
   }
 
 
  public:
   CSRGraph() : directed_(false), num_nodes_(-1), num_edges_(-1),
-    out_index_(nullptr), out_neighbors_(nullptr),
-    in_index_(nullptr), in_neighbors_(nullptr) {}
+    out_neighbors_(nullptr), in_neighbors_(nullptr) {}
 
-  CSRGraph(int64_t num_nodes, DestID_** index, DestID_* neighs) :
+  CSRGraph(int64_t num_nodes, CSROffsets offsets, DestID_* neighs,
+           std::shared_ptr<MappedFile> mapping = nullptr) :
     directed_(false), num_nodes_(num_nodes),
-    out_index_(index), out_neighbors_(neighs),
-    in_index_(index), in_neighbors_(neighs) {
-      num_edges_ = (out_index_[num_nodes_] - out_index_[0]) / 2;
+    out_offsets_(offsets), out_neighbors_(neighs),
+    in_offsets_(offsets), in_neighbors_(neighs), mapping_(mapping) {
+      num_edges_ = (out_offsets_[num_nodes_] - out_offsets_[0]) / 2;
     }
 
-  CSRGraph(int64_t num_nodes, DestID_** out_index, DestID_* out_neighs,
-        DestID_** in_index, DestID_* in_neighs) :
+  CSRGraph(int64_t num_nodes, CSROffsets out_offsets, DestID_* out_neighs,
+        CSROffsets in_offsets, DestID_* in_neighs,
+        std::shared_ptr<MappedFile> mapping = nullptr) :
     directed_(true), num_nodes_(num_nodes),
-    out_index_(out_index), out_neighbors_(out_neighs),
-    in_index_(in_index), in_neighbors_(in_neighs) {
-      num_edges_ = out_index_[num_nodes_] - out_index_[0];
+    out_offsets_(out_offsets), out_neighbors_(out_neighs),
+    in_offsets_(in_offsets), in_neighbors_(in_neighs), mapping_(mapping) {
+      num_edges_ = out_offsets_[num_nodes_] - out_offsets_[0];
     }
 
   CSRGraph(CSRGraph&& other) : directed_(other.directed_),
     num_nodes_(other.num_nodes_), num_edges_(other.num_edges_),
-    out_index_(other.out_index_), out_neighbors_(other.out_neighbors_),
-    in_index_(other.in_index_), in_neighbors_(other.in_neighbors_) {
+    out_offsets_(other.out_offsets_), out_neighbors_(other.out_neighbors_),
+    in_offsets_(other.in_offsets_), in_neighbors_(other.in_neighbors_),
+    mapping_(std::move(other.mapping_)) {
       other.num_edges_ = -1;
       other.num_nodes_ = -1;
-      other.out_index_ = nullptr;
+      other.out_offsets_ = CSROffsets();
       other.out_neighbors_ = nullptr;
-      other.in_index_ = nullptr;
+      other.in_offsets_ = CSROffsets();
       other.in_neighbors_ = nullptr;
   }
 
@@ -172,15 +395,16 @@ class CSRGraph {
       directed_ = other.directed_;
       num_edges_ = other.num_edges_;
       num_nodes_ = other.num_nodes_;
-      out_index_ = other.out_index_;
+      out_offsets_ = other.out_offsets_;
       out_neighbors_ = other.out_neighbors_;
-      in_index_ = other.in_index_;
+      in_offsets_ = other.in_offsets_;
       in_neighbors_ = other.in_neighbors_;
+      mapping_ = std::move(other.mapping_);
       other.num_edges_ = -1;
       other.num_nodes_ = -1;
-      other.out_index_ = nullptr;
+      other.out_offsets_ = CSROffsets();
       other.out_neighbors_ = nullptr;
-      other.in_index_ = nullptr;
+      other.in_offsets_ = CSROffsets();
       other.in_neighbors_ = nullptr;
     }
     return *this;
@@ -203,21 +427,23 @@ class CSRGraph {
   }
 
   int64_t out_degree(NodeID_ v) const {
-    return out_index_[v+1] - out_index_[v];
+    return out_offsets_[v+1] - out_offsets_[v];
   }
 
   int64_t in_degree(NodeID_ v) const {
     static_assert(MakeInverse, "Graph inversion disabled but reading inverse");
-    return in_index_[v+1] - in_index_[v];
+    return in_offsets_[v+1] - in_offsets_[v];
   }
 
   Neighborhood out_neigh(NodeID_ n, OffsetT start_offset = 0) const {
-    return Neighborhood(n, out_index_, start_offset);
+    return Neighborhood(out_neighbors_ + out_offsets_[n],
+                        out_neighbors_ + out_offsets_[n+1], start_offset);
   }
 
   Neighborhood in_neigh(NodeID_ n, OffsetT start_offset = 0) const {
     static_assert(MakeInverse, "Graph inversion disabled but reading inverse");
-    return Neighborhood(n, in_index_, start_offset);
+    return Neighborhood(in_neighbors_ + in_offsets_[n],
+                        in_neighbors_ + in_offsets_[n+1], start_offset);
   }
 
   void PrintStats() const {
@@ -246,25 +472,19 @@ class CSRGraph {
     PrintAligned("Max Degree", max_degree);
   }
 
-  static DestID_** GenIndex(const pvector<SGOffset> &offsets, DestID_* neighs) {
-    NodeID_ length = offsets.size();
-    DestID_** index = new DestID_*[length];
-    #pragma omp parallel for
-    for (NodeID_ n=0; n < length; n++)
-      index[n] = neighs + offsets[n];
-    return index;
-  }
-
   pvector<SGOffset> VertexOffsets(bool in_graph = false) const {
+    const CSROffsets &index = in_graph ? in_offsets_ : out_offsets_;
     pvector<SGOffset> offsets(num_nodes_+1);
+    #pragma omp parallel for
     for (NodeID_ n=0; n < num_nodes_+1; n++)
-      if (in_graph)
-        offsets[n] = in_index_[n] - in_index_[0];
-      else
-        offsets[n] = out_index_[n] - out_index_[0];
+      offsets[n] = index[n] - index[0];
     return offsets;
   }
 
+  bool narrow_offsets() const {
+    return out_offsets_.narrow();
+  }
+
   Range<NodeID_> vertices() const {
     return Range<NodeID_>(num_nodes());
   }
@@ -273,10 +493,11 @@ class CSRGraph {
   bool directed_;
   int64_t num_nodes_;
   int64_t num_edges_;
-  DestID_** out_index_;
-  DestID_*  out_neighbors_;
-  DestID_** in_index_;
-  DestID_*  in_neighbors_;
+  CSROffsets out_offsets_;
+  DestID_*   out_neighbors_;
+  CSROffsets in_offsets_;
+  DestID_*   in_neighbors_;
+  std::shared_ptr<MappedFile> mapping_;
 };
 
 #endif  // GRAPH_H_
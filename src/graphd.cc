@@ -0,0 +1,57 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#include <iostream>
+
+#include "benchmark.h"
+#include "builder.h"
+#include "command_line.h"
+#include "graph.h"
+#include "mapped_file.h"
+#include "writer.h"
+
+/*
+GAP Benchmark Suite
+Tool: graphd
+
+Loads or builds a graph once and publishes it into memory, so benchmark
+processes attach to it (-G) instead of each loading it again
+ - graphd -g 26 -G shm:kron26 publishes into POSIX shared memory, where the
+   graph stays until removed (rm /dev/shm/kron26.sg) or reboot
+ - graphd -f twitter.sg -G /mnt/huge/twitter publishes onto a hugetlbfs mount
+ - -w publishes the weighted graph (.wsg) under the same name
+*/
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+  CLGraphd cli(argc, argv, "graphd");
+  if (!cli.ParseArgs())
+    return -1;
+  if (cli.publish_name() == "") {
+    cout << "No name to publish under given (-G)" << endl;
+    return -1;
+  }
+  string filename = SharedGraphFilename(cli.publish_name(), cli.weighted());
+  Timer t;
+  if (cli.weighted()) {
+    WeightedBuilder bw(cli);
+    WGraph wg = bw.MakeGraph();
+    wg.PrintStats();
+    t.Start();
+    WeightedWriter ww(wg);
+    ww.WriteSharedGraph(filename);
+    t.Stop();
+  } else {
+    Builder b(cli);
+    Graph g = b.MakeGraph();
+    g.PrintStats();
+    t.Start();
+    Writer w(g);
+    w.WriteSharedGraph(filename);
+    t.Stop();
+  }
+  PrintTime("Publish Time", t.Seconds());
+  PrintLabel("Published", filename);
+  return 0;
+}
@@ -0,0 +1,195 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+
+/*
+GAP Benchmark Suite
+Class:  MappedFile
+
+Read-only memory mapping of a whole file
+ - Hints are a comma-separated list of:
+     none       map without hints
+     populate   prefault all pages at map time (MAP_POPULATE)
+     willneed   start readahead of the whole file (MADV_WILLNEED)
+     sequential expect sequential access (MADV_SEQUENTIAL)
+     random     expect random access, disables readahead (MADV_RANDOM)
+     hugepage   back the mapping with transparent huge pages if the
+                filesystem supports it (MADV_HUGEPAGE)
+ - Unmapped when the last owner (usually a CSRGraph) is destroyed
+*/
+
+
+class MappedFile {
+ public:
+  MappedFile(std::string filename, std::string hints) {
+    int flags = MAP_PRIVATE;
+    int advice[4];
+    int num_advice = 0;
+    std::stringstream hint_stream(hints);
+    std::string hint;
+    while (std::getline(hint_stream, hint, ',')) {
+      if (hint == "populate") {
+        flags |= MAP_POPULATE;
+      } else if (hint == "willneed") {
+        advice[num_advice++] = MADV_WILLNEED;
+      } else if (hint == "sequential") {
+        advice[num_advice++] = MADV_SEQUENTIAL;
+      } else if (hint == "random") {
+        advice[num_advice++] = MADV_RANDOM;
+      } else if (hint == "hugepage") {
+        advice[num_advice++] = MADV_HUGEPAGE;
+      } else if (hint != "none" && hint != "") {
+        std::cout << "Unknown mmap hint " << hint << std::endl;
+        std::exit(-6);
+      }
+      if (num_advice == 4)
+        break;
+    }
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+      std::cout << "Couldn't open file " << filename << std::endl;
+      std::exit(-6);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1) {
+      std::cout << "Couldn't stat file " << filename << std::endl;
+      std::exit(-6);
+    }
+    size_ = file_stat.st_size;
+    if (size_ == 0) {   // mmap refuses empty mappings
+      close(fd);
+      data_ = nullptr;
+      return;
+    }
+    data_ = static_cast<char*>(mmap(nullptr, size_, PROT_READ, flags, fd, 0));
+    close(fd);
+    if (data_ == MAP_FAILED) {
+      std::cout << "Couldn't map file " << filename << std::endl;
+      std::exit(-6);
+    }
+    // Hints are best effort, e.g., hugepage is refused by most filesystems
+    for (int i=0; i < num_advice; i++)
+      madvise(data_, size_, advice[i]);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (data_ != nullptr)
+      munmap(data_, size_);
+  }
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  bool contains(const void* ptr) const {
+    const char* p = static_cast<const char*>(ptr);
+    return (p >= data_) && (p < data_ + size_);
+  }
+
+ private:
+  char* data_;
+  size_t size_;
+};
+
+
+// File of a graph published by graphd (-G name): shm:name is a POSIX shared
+// memory object (a file in /dev/shm on Linux), any other name is a path
+// prefix, e.g., on a hugetlbfs mount
+inline std::string SharedGraphFilename(std::string name, bool weighted) {
+  std::string suffix = weighted ? ".wsg" : ".sg";
+  if (name.compare(0, 4, "shm:") == 0)
+    return "/dev/shm/" + name.substr(4) + suffix;
+  return name + suffix;
+}
+
+
+// Copies a large block in parallel (e.g., out of a mapping)
+inline void ParallelCopy(void* dst, const void* src, size_t num_bytes) {
+  const size_t kChunkBytes = 1 << 22;
+  char* d = static_cast<char*>(dst);
+  const char* s = static_cast<const char*>(src);
+  int64_t num_chunks = (num_bytes + kChunkBytes - 1) / kChunkBytes;
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int64_t c=0; c < num_chunks; c++) {
+    size_t begin = c * kChunkBytes;
+    size_t length = std::min(kChunkBytes, num_bytes - begin);
+    std::memcpy(d + begin, s + begin, length);
+  }
+}
+
+
+// Reads (or writes) num_bytes at offset of an open file with positional I/O
+// by many threads at once, returns false on an I/O error or end of file
+inline bool ParallelPositionalIO(int fd, char* buffer, size_t num_bytes,
+                                 off_t offset, bool write) {
+  const size_t kChunkBytes = 1 << 24;
+  int64_t num_chunks = (num_bytes + kChunkBytes - 1) / kChunkBytes;
+  bool failed = false;
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int64_t c=0; c < num_chunks; c++) {
+    size_t done = c * kChunkBytes;
+    size_t end = std::min(done + kChunkBytes, num_bytes);
+    while (done < end) {
+      ssize_t moved = write ?
+        pwrite(fd, buffer + done, end - done, offset + done) :
+        pread(fd, buffer + done, end - done, offset + done);
+      if (moved <= 0) {
+        #pragma omp atomic write
+        failed = true;
+        break;
+      }
+      done += moved;
+    }
+  }
+  return !failed;
+}
+
+
+// Creates filename with num_bytes mapped writable and shared, so whatever is
+// written stays in the file system's memory (tmpfs or hugetlbfs) after
+// unmapping. The size is rounded up to the file system's block (huge page)
+// size, since hugetlbfs refuses anything else.
+inline char* CreateSharedMapping(std::string filename, size_t num_bytes,
+                                 size_t* mapped_bytes) {
+  int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    std::cout << "Couldn't create " << filename << std::endl;
+    std::exit(-5);
+  }
+  struct statfs fs_stat;
+  size_t block_bytes = fstatfs(fd, &fs_stat) == 0 ? fs_stat.f_bsize : 4096;
+  *mapped_bytes = (num_bytes + block_bytes - 1) / block_bytes * block_bytes;
+  if (ftruncate(fd, *mapped_bytes) == -1) {
+    std::cout << "Couldn't size " << filename << " to " << *mapped_bytes
+              << " bytes" << std::endl;
+    std::exit(-5);
+  }
+  void* data = mmap(nullptr, *mapped_bytes, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    std::cout << "Couldn't map " << filename << std::endl;
+    std::exit(-5);
+  }
+  return static_cast<char*>(data);
+}
+
+#endif  // MAPPED_FILE_H_
@@ -6,6 +6,8 @@
 
 #include <algorithm>
 
+#include "allocator.h"
+
 
 /*
 GAP Benchmark Suite
@@ -16,6 +18,9 @@ Vector class with ability to not initialize or do initialization in parallel
  - std::vector (when resizing) will always initialize, and does so serially
  - When pvector is resized, new elements are uninitialized
  - Resizing is not thread-safe
+ - Storage comes from PageAllocator, so large vectors follow the page policy
+ - Initialization is parallel with a static schedule (like most kernels use),
+   so on NUMA machines pages are first touched near the threads using them
 */
 
 
@@ -27,7 +32,7 @@ class pvector {
   pvector() : start_(nullptr), end_size_(nullptr), end_capacity_(nullptr) {}
 
   explicit pvector(size_t num_elements) {
-    start_ = new T_[num_elements];
+    start_ = AllocateArray<T_>(num_elements);
     end_size_ = start_ + num_elements;
     end_capacity_ = end_size_;
   }
@@ -38,7 +43,7 @@ class pvector {
 
   pvector(iterator copy_begin, iterator copy_end)
       : pvector(copy_end - copy_begin) {
-    #pragma omp parallel for
+    #pragma omp parallel for schedule(static)
     for (size_t i=0; i < capacity(); i++)
       start_[i] = copy_begin[i];
   }
@@ -71,7 +76,7 @@ class pvector {
 
   void ReleaseResources(){
     if (start_ != nullptr) {
-      delete[] start_;
+      FreeArray(start_);
     }
   }
 
@@ -82,12 +87,12 @@ class pvector {
   // not thread-safe
   void reserve(size_t num_elements) {
     if (num_elements > capacity()) {
-      T_ *new_range = new T_[num_elements];
-      #pragma omp parallel for
+      T_ *new_range = AllocateArray<T_>(num_elements);
+      #pragma omp parallel for schedule(static)
       for (size_t i=0; i < size(); i++)
         new_range[i] = start_[i];
       end_size_ = new_range + size();
-      delete[] start_;
+      FreeArray(start_);
       start_ = new_range;
       end_capacity_ = start_ + num_elements;
     }
@@ -130,7 +135,7 @@ class pvector {
   }
 
   void fill(T_ init_val) {
-    #pragma omp parallel for
+    #pragma omp parallel for schedule(static)
     for (T_* ptr=start_; ptr < end_size_; ptr++)
       *ptr = init_val;
   }
@@ -4,13 +4,23 @@
 #ifndef READER_H_
 #define READER_H_
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <type_traits>
+#include <vector>
 
+#include "compressed_graph.h"
+#include "mapped_file.h"
 #include "pvector.h"
+#include "text_parser.h"
 #include "util.h"
 
 
@@ -24,7 +34,11 @@ Given filename, returns an edgelist or the entire graph (if serialized)
  - Determines file format from the filename's suffix
  - If the input graph is serialized (.sg or .wsg), reads the graph
    directly into the returned graph instance
+ - Compressed serialized graphs (.csg) are read with ReadCompressedGraph
  - Otherwise, reads the file and returns an edgelist
+ - Edge lists (.el, .wel, .gr, .mtx) are mapped and parsed in parallel
+ - Binary edge lists (.bel, .wbel) are read in parallel with pread, their
+   vertex count is available from num_nodes() afterwards
 */
 
 
@@ -33,7 +47,9 @@ template <typename NodeID_, typename DestID_ = NodeID_,
 class Reader {
   typedef EdgePair<NodeID_, DestID_> Edge;
   typedef pvector<Edge> EdgeList;
+  typedef NodeWeight<NodeID_, WeightT_> WNode;
   std::string filename_;
+  int64_t num_nodes_ = -1;
 
  public:
   explicit Reader(std::string filename) : filename_(filename) {}
@@ -47,43 +63,209 @@ class Reader {
     return filename_.substr(suff_pos);
   }
 
-  EdgeList ReadInEL(std::ifstream &in) {
-    EdgeList el;
-    NodeID_ u, v;
-    while (in >> u >> v) {
-      el.push_back(Edge(u, v));
+  /*
+  Parses the text in [begin, end) in parallel
+    - Splits it into blocks at line boundaries, parse_block(cursor, edges)
+      parses each block into its own buffer
+    - parse_block returns false if it stopped at malformed input, edges of
+      later blocks are then dropped, just like a stream would stop there
+    - Buffers are concatenated at offsets from a prefix sum
+    - If given, *all_parsed tells whether no block stopped early
+  */
+  template <typename ParseFunc>
+  EdgeList ParseInParallel(const char* begin, const char* end,
+                           ParseFunc parse_block, bool* all_parsed = nullptr) {
+    const size_t kBlockBytes = 1 << 22;
+    int64_t num_blocks = std::max<int64_t>(
+      1, (end - begin + kBlockBytes - 1) / kBlockBytes);
+    std::vector<const char*> bounds(num_blocks + 1);
+    bounds[0] = begin;
+    bounds[num_blocks] = end;
+    for (int64_t b=1; b < num_blocks; b++) {
+      const char* split = std::max(begin + b * kBlockBytes, bounds[b-1]);
+      const void* newline = std::memchr(split, '\n', end - split);
+      bounds[b] = newline ? static_cast<const char*>(newline) + 1 : end;
+    }
+    std::vector<std::vector<Edge>> buffers(num_blocks);
+    std::vector<char> complete(num_blocks);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t b=0; b < num_blocks; b++) {
+      TextCursor cursor(bounds[b], bounds[b+1]);
+      complete[b] = parse_block(cursor, buffers[b]);
+    }
+    int64_t num_used = 0;
+    while ((num_used < num_blocks) && complete[num_used++]) {}
+    if (all_parsed != nullptr)
+      *all_parsed = complete[num_used - 1];
+    pvector<SGOffset> offsets(num_used + 1);
+    offsets[0] = 0;
+    for (int64_t b=0; b < num_used; b++)
+      offsets[b+1] = offsets[b] + buffers[b].size();
+    EdgeList el(offsets[num_used]);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t b=0; b < num_used; b++) {
+      std::copy(buffers[b].begin(), buffers[b].end(), el.begin() + offsets[b]);
+      std::vector<Edge>().swap(buffers[b]);
     }
     return el;
   }
 
-  EdgeList ReadInWEL(std::ifstream &in) {
-    EdgeList el;
+  static bool ParseWeighted(TextCursor &cursor,
+                            NodeWeight<NodeID_, WeightT_> &v) {
+    return cursor.Parse(v.v) && cursor.Parse(v.w);
+  }
+
+  static bool ParseELBlock(TextCursor &cursor, std::vector<Edge> &edges) {
+    NodeID_ u, v;
+    while (cursor.Parse(u) && cursor.Parse(v))
+      edges.push_back(Edge(u, v));
+    return cursor.done();
+  }
+
+  static bool ParseWELBlock(TextCursor &cursor, std::vector<Edge> &edges) {
     NodeID_ u;
     NodeWeight<NodeID_, WeightT_> v;
-    while (in >> u >> v) {
-      el.push_back(Edge(u, v));
-    }
-    return el;
+    while (cursor.Parse(u) && ParseWeighted(cursor, v))
+      edges.push_back(Edge(u, v));
+    return cursor.done();
+  }
+
+  EdgeList ReadInEL(const MappedFile &file) {
+    return ParseInParallel(file.data(), file.data() + file.size(),
+                           ParseELBlock);
+  }
+
+  EdgeList ReadInWEL(const MappedFile &file) {
+    return ParseInParallel(file.data(), file.data() + file.size(),
+                           ParseWELBlock);
   }
 
   // Note: converts vertex numbering from 1..N to 0..N-1
-  EdgeList ReadInGR(std::ifstream &in) {
-    EdgeList el;
-    char c;
-    NodeID_ u;
-    NodeWeight<NodeID_, WeightT_> v;
-    while (!in.eof()) {
-      c = in.peek();
-      if (c == 'a') {
-        in >> c >> u >> v;
-        el.push_back(Edge(u - 1, NodeWeight<NodeID_, WeightT_>(v.v-1, v.w)));
-      } else {
-        in.ignore(200, '\n');
+  EdgeList ReadInGR(const MappedFile &file) {
+    return ParseInParallel(file.data(), file.data() + file.size(),
+        [](TextCursor &cursor, std::vector<Edge> &edges) {
+      NodeID_ u;
+      NodeWeight<NodeID_, WeightT_> v;
+      while (!cursor.done()) {
+        if (cursor.peek() == 'a') {
+          cursor.Skip(1);
+          if (!(cursor.Parse(u) && ParseWeighted(cursor, v)))
+            return false;
+          edges.push_back(
+            Edge(u - 1, NodeWeight<NodeID_, WeightT_>(v.v-1, v.w)));
+        }
+        cursor.SkipLine();
       }
+      return true;
+    });
+  }
+
+  // Reads edges [first, first+num_edges) stored as FileEdge and converts
+  // them to Edge if needed
+  template <typename FileEdge>
+  EdgeList ReadInBEL(int fd, int64_t first, int64_t num_edges) {
+    pvector<FileEdge> file_el(num_edges);
+    if (!ParallelPositionalIO(fd, reinterpret_cast<char*>(file_el.data()),
+                              num_edges * sizeof(FileEdge),
+                              sizeof(BELHeader) + first * sizeof(FileEdge),
+                              false)) {
+      std::cout << "Truncated binary edge list " << filename_ << std::endl;
+      std::exit(-6);
+    }
+    if constexpr (std::is_same<FileEdge, Edge>::value) {
+      return file_el;
+    } else {
+      EdgeList el(file_el.size());
+      #pragma omp parallel for
+      for (size_t e=0; e < file_el.size(); e++)
+        el[e] = Edge(file_el[e].u, DestID_(file_el[e].v));
+      return el;
+    }
+  }
+
+  EdgeList ReadInBEL(int fd, bool weighted, int64_t first, int64_t num_edges) {
+    if (weighted)
+      return ReadInBEL<EdgePair<NodeID_, WNode>>(fd, first, num_edges);
+    else
+      return ReadInBEL<EdgePair<NodeID_, NodeID_>>(fd, first, num_edges);
+  }
+
+  // Opens binary edge list and checks its header
+  int OpenBEL(bool weighted, BELHeader &header) {
+    int fd = open(filename_.c_str(), O_RDONLY);
+    if ((fd == -1) || (pread(fd, &header, sizeof(header), 0) !=
+                       sizeof(header)) ||
+        (std::memcmp(header.magic, kBELMagic, sizeof(kBELMagic)) != 0)) {
+      std::cout << "Couldn't read binary edge list " << filename_ << std::endl;
+      std::exit(-6);
+    }
+    if ((header.id_bytes != sizeof(NodeID_)) ||
+        (header.dest_bytes != (weighted ? sizeof(WNode) : sizeof(NodeID_)))) {
+      std::cout << "Binary edge list " << filename_ << " has "
+                << header.id_bytes << "B IDs and " << header.dest_bytes
+                << "B destinations, built for " << sizeof(NodeID_) << "B"
+                << std::endl;
+      std::exit(-5);
     }
+    num_nodes_ = header.num_nodes;
+    return fd;
+  }
+
+  EdgeList ReadInBEL(bool weighted) {
+    BELHeader header;
+    int fd = OpenBEL(weighted, header);
+    EdgeList el = ReadInBEL(fd, weighted, 0, header.num_edges);
+    close(fd);
     return el;
   }
 
+  /*
+  Calls process(chunk) on consecutive chunks of the edges of an .el, .wel,
+  .bel or .wbel file, each holding roughly at most max_edges edges
+    - Concatenated, the chunks are the edge list ReadFile would return
+    - Used to build graphs too large to hold the whole edge list in memory
+  */
+  template <typename ChunkFunc>
+  void StreamFile(int64_t max_edges, bool &needs_weights, ChunkFunc process) {
+    std::string suffix = GetSuffix();
+    if ((suffix == ".bel") || (suffix == ".wbel")) {
+      bool weighted = suffix == ".wbel";
+      if (weighted)
+        needs_weights = false;
+      BELHeader header;
+      int fd = OpenBEL(weighted, header);
+      for (int64_t first=0; first < header.num_edges; first += max_edges) {
+        EdgeList chunk = ReadInBEL(fd, weighted, first,
+            std::min(max_edges, header.num_edges - first));
+        process(chunk);
+      }
+      close(fd);
+    } else if ((suffix == ".el") || (suffix == ".wel")) {
+      bool weighted = suffix == ".wel";
+      if (weighted)
+        needs_weights = false;
+      // Each edge takes at least 4 (el) or 6 (wel) characters
+      const size_t kChunkBytes = max_edges * (weighted ? 6 : 4);
+      MappedFile file(filename_, "sequential");
+      const char* pos = file.data();
+      const char* end = file.data() + file.size();
+      bool all_parsed = true;
+      while ((pos < end) && all_parsed) {
+        const char* split = pos + std::min<size_t>(kChunkBytes, end - pos);
+        const void* newline = std::memchr(split, '\n', end - split);
+        split = newline ? static_cast<const char*>(newline) + 1 : end;
+        EdgeList chunk = ParseInParallel(pos, split,
+            weighted ? ParseWELBlock : ParseELBlock, &all_parsed);
+        process(chunk);
+        pos = split;
+      }
+    } else {
+      std::cout << "Streaming only supports .el, .wel, .bel and .wbel"
+                << std::endl;
+      std::exit(-3);
+    }
+  }
+
   // Note: converts vertex numbering from 1..N to 0..N-1
   EdgeList ReadInMetis(std::ifstream &in, bool &needs_weights) {
     EdgeList el;
@@ -146,7 +328,7 @@ class Reader {
   // Note: weights casted to type WeightT_
   EdgeList ReadInMTX(std::ifstream &in, bool &needs_weights) {
     EdgeList el;
-    std::string start, object, format, field, symmetry, line;
+    std::string start, object, format, field, symmetry;
     in >> start >> object >> format >> field >> symmetry >> std::ws;
     if (start != "%%MatrixMarket") {
       std::cout << ".mtx file did not start with %%MatrixMarket" << std::endl;
@@ -194,27 +376,42 @@ class Reader {
       std::cout << "matrix must be square for .mtx" << std::endl;
       std::exit(-26);
     }
-    while (std::getline(in, line)) {
-      if (line.empty())
-        continue;
-      std::istringstream edge_stream(line);
+    // Header is read with the stream, entries are parsed in parallel
+    MappedFile file(filename_, "sequential");
+    size_t header_bytes = in.eof() ? file.size() :
+                          static_cast<size_t>(in.tellg());
+    const char* data_start = file.data() + header_bytes;
+    el = ParseInParallel(data_start, file.data() + file.size(),
+        [&](TextCursor &cursor, std::vector<Edge> &edges) {
       NodeID_ u;
-      edge_stream >> u;
-      if (read_weights) {
-        NodeWeight<NodeID_, WeightT_> v;
-        edge_stream >> v;
-        v.v -= 1;
-        el.push_back(Edge(u - 1, v));
-        if (undirected)
-          el.push_back(Edge(v.v, NodeWeight<NodeID_, WeightT_>(u - 1, v.w)));
-      } else {
-        NodeID_ v;
-        edge_stream >> v;
-        el.push_back(Edge(u - 1, v - 1));
-        if (undirected)
-          el.push_back(Edge(v - 1, u - 1));
+      while (!cursor.done()) {
+        if ((cursor.peek() == '\n') || (cursor.peek() == '%')) {
+          cursor.SkipLine();
+          continue;
+        }
+        if (!cursor.Parse(u))
+          return false;
+        if (read_weights) {
+          NodeWeight<NodeID_, WeightT_> v;
+          if (!ParseWeighted(cursor, v))
+            return false;
+          v.v -= 1;
+          edges.push_back(Edge(u - 1, v));
+          if (undirected)
+            edges.push_back(
+              Edge(v.v, NodeWeight<NodeID_, WeightT_>(u - 1, v.w)));
+        } else {
+          NodeID_ v;
+          if (!cursor.Parse(v))
+            return false;
+          edges.push_back(Edge(u - 1, v - 1));
+          if (undirected)
+            edges.push_back(Edge(v - 1, u - 1));
+        }
+        cursor.SkipLine();
       }
-    }
+      return true;
+    });
     needs_weights = !read_weights;
     return el;
   }
@@ -230,13 +427,18 @@ class Reader {
       std::exit(-2);
     }
     if (suffix == ".el") {
-      el = ReadInEL(file);
+      el = ReadInEL(MappedFile(filename_, "sequential"));
     } else if (suffix == ".wel") {
       needs_weights = false;
-      el = ReadInWEL(file);
+      el = ReadInWEL(MappedFile(filename_, "sequential"));
     } else if (suffix == ".gr") {
       needs_weights = false;
-      el = ReadInGR(file);
+      el = ReadInGR(MappedFile(filename_, "sequential"));
+    } else if (suffix == ".bel") {
+      el = ReadInBEL(false);
+    } else if (suffix == ".wbel") {
+      needs_weights = false;
+      el = ReadInBEL(true);
     } else if (suffix == ".graph") {
       el = ReadInMetis(file, needs_weights);
     } else if (suffix == ".mtx") {
@@ -251,10 +453,15 @@ class Reader {
     return el;
   }
 
-  CSRGraph<NodeID_, DestID_, invert> ReadSerializedGraph() {
+  // Number of vertices recorded by the file, -1 if not known
+  int64_t num_nodes() const { return num_nodes_; }
+
+  void CheckSerializedTypes() {
     bool weighted = GetSuffix() == ".wsg";
-    if (!std::is_same<NodeID_, SGID>::value) {
-      std::cout << "serialized graphs only allowed for 32bit" << std::endl;
+    if (!std::is_same<NodeID_, SGID>::value &&
+        !std::is_same<NodeID_, int64_t>::value) {
+      std::cout << "serialized graphs only allowed for 32b or 64b IDs"
+                << std::endl;
       std::exit(-5);
     }
     if (!weighted && !std::is_same<NodeID_, DestID_>::value) {
@@ -269,6 +476,259 @@ class Reader {
       std::cout << ".wsg only allowed for int32_t weights" << std::endl;
       std::exit(-5);
     }
+  }
+
+  // Neighbors of a file written with 32-bit IDs
+  typedef typename std::conditional<std::is_same<NodeID_, DestID_>::value,
+                                    SGID, NodeWeight<SGID, WeightT_>>::type
+          NarrowDestID;
+
+  static DestID_ Widen(const NarrowDestID &n) {
+    if constexpr (std::is_same<NodeID_, DestID_>::value)
+      return n;
+    else
+      return DestID_(n.v, n.w);
+  }
+
+  // Returns whether the file has 32-bit IDs that need widening, exits if the
+  // file's IDs are wider than NodeID_
+  bool CheckSerializedIDs(uint8_t flags) {
+    bool wide_ids = flags & kSGWideIDs;
+    if (wide_ids && sizeof(NodeID_) < sizeof(int64_t)) {
+      std::cout << filename_ << " has 64-bit IDs, needs a build with "
+                << "make NODEID=64" << std::endl;
+      std::exit(-5);
+    }
+    return !wide_ids && !std::is_same<NodeID_, SGID>::value;
+  }
+
+  // Header of a v2 file, or one laying out a v1 file the same way (version 1,
+  // without checksums)
+  SGHeader ParseSGHeader(const char* bytes, size_t num_bytes) {
+    SGHeader header;
+    if ((num_bytes >= sizeof(SGHeader)) &&
+        (std::memcmp(bytes, kSGMagic, sizeof(kSGMagic)) == 0)) {
+      std::memcpy(&header, bytes, sizeof(SGHeader));
+      return header;
+    }
+    int64_t pos = sizeof(uint8_t) + 2 * sizeof(SGOffset);
+    if (num_bytes < static_cast<size_t>(pos)) {
+      std::cout << "Truncated serialized graph " << filename_ << std::endl;
+      std::exit(-6);
+    }
+    uint8_t flags;
+    SGOffset num_edges, num_nodes;
+    std::memcpy(&flags, bytes, sizeof(uint8_t));
+    std::memcpy(&num_edges, bytes + sizeof(uint8_t), sizeof(SGOffset));
+    std::memcpy(&num_nodes, bytes + sizeof(uint8_t) + sizeof(SGOffset),
+                sizeof(SGOffset));
+    bool wide_ids = flags & kSGWideIDs;
+    uint32_t id_bytes = wide_ids ? sizeof(int64_t) : sizeof(SGID);
+    uint32_t dest_bytes = id_bytes == sizeof(NodeID_) ? sizeof(DestID_)
+                                                      : sizeof(NarrowDestID);
+    header = MakeSGHeader(flags & kSGDirected, num_nodes, num_edges, id_bytes,
+                          dest_bytes);
+    header.version = 1;
+    for (uint32_t s=0; s < header.num_sections; s++) {
+      header.sections[s].start = pos;
+      pos += header.sections[s].num_bytes;
+    }
+    return header;
+  }
+
+  // Checks header against this build, returns whether IDs need widening
+  bool CheckSGHeader(const SGHeader &header) {
+    if (header.version > kSGVersion) {
+      std::cout << filename_ << " is a newer serialized graph (v"
+                << header.version << ")" << std::endl;
+      std::exit(-5);
+    }
+    bool widen = CheckSerializedIDs(header.flags);
+    SGHeader expected = MakeSGHeader(
+      header.flags & kSGDirected, header.num_nodes, header.num_edges,
+      header.id_bytes, widen ? sizeof(NarrowDestID) : sizeof(DestID_));
+    bool matches = (header.offset_bytes == expected.offset_bytes) &&
+                   (header.dest_bytes == expected.dest_bytes) &&
+                   (header.num_sections == expected.num_sections);
+    for (uint32_t s=0; matches && (s < header.num_sections); s++) {
+      matches = header.sections[s].num_bytes ==
+                expected.sections[s].num_bytes;
+      if (header.version >= 2)
+        matches &= header.sections[s].start == expected.sections[s].start;
+    }
+    if (!matches) {
+      std::cout << "Inconsistent serialized graph header in " << filename_
+                << std::endl;
+      std::exit(-5);
+    }
+    return widen;
+  }
+
+  void CheckSection(const SGHeader &header, int s, const void* data) {
+    if (SGChecksum::Of(data, header.sections[s].num_bytes) !=
+        header.sections[s].checksum) {
+      std::cout << "Checksum mismatch in section " << s << " of "
+                << filename_ << std::endl;
+      std::exit(-6);
+    }
+  }
+
+  // Reads the sections with parallel positional reads and checks them
+  // against their checksums (v2 only, unless verify is false)
+  CSRGraph<NodeID_, DestID_, invert> ReadSerializedGraph(bool verify = true) {
+    CheckSerializedTypes();
+    int fd = open(filename_.c_str(), O_RDONLY);
+    if (fd == -1) {
+      std::cout << "Couldn't open file " << filename_ << std::endl;
+      std::exit(-6);
+    }
+    Timer t;
+    t.Start();
+    char first_bytes[sizeof(SGHeader)];
+    ssize_t num_first = pread(fd, first_bytes, sizeof(SGHeader), 0);
+    SGHeader header = ParseSGHeader(first_bytes,
+                                    std::max<ssize_t>(num_first, 0));
+    bool widen = CheckSGHeader(header);
+    bool directed = header.flags & kSGDirected;
+    verify &= header.version >= 2;
+    auto read_section = [&](int s, void* data) {
+      const SGSection &section = header.sections[s];
+      if (!ParallelPositionalIO(fd, static_cast<char*>(data),
+                                section.num_bytes, section.start, false)) {
+        std::cout << "Truncated serialized graph " << filename_ << std::endl;
+        std::exit(-6);
+      }
+      if (verify)
+        CheckSection(header, s, data);
+    };
+    auto read_offsets = [&](int s) {
+      pvector<SGOffset> offsets(header.num_nodes + 1);
+      read_section(s, offsets.data());
+      return CSROffsets::Adopt(std::move(offsets));
+    };
+    auto read_neighs = [&](int s) {
+      DestID_* neighs = AllocateArray<DestID_>(header.num_edges);
+      if (!widen) {
+        read_section(s, neighs);
+      } else {
+        pvector<NarrowDestID> narrow(header.num_edges);
+        read_section(s, narrow.data());
+        #pragma omp parallel for
+        for (SGOffset e=0; e < header.num_edges; e++)
+          neighs[e] = Widen(narrow[e]);
+      }
+      return neighs;
+    };
+    CSROffsets index, inv_index;
+    DestID_ *neighs = nullptr, *inv_neighs = nullptr;
+    index = read_offsets(0);
+    neighs = read_neighs(1);
+    if (directed && invert) {
+      inv_index = read_offsets(2);
+      inv_neighs = read_neighs(3);
+    }
+    close(fd);
+    t.Stop();
+    PrintTime("Read Time", t.Seconds());
+    if (directed)
+      return CSRGraph<NodeID_, DestID_, invert>(header.num_nodes, index,
+                                                neighs, inv_index, inv_neighs);
+    else
+      return CSRGraph<NodeID_, DestID_, invert>(header.num_nodes, index,
+                                                neighs);
+  }
+
+  // Same result as ReadSerializedGraph, but maps the file instead of reading
+  // it. Offset and neighbor arrays suitably aligned in the file (all of them
+  // in v2 files) are used in place (and the graph keeps the mapping alive),
+  // all others are copied out in parallel. Offsets used in place stay 64
+  // bits wide. Checking checksums reads the whole file once.
+  CSRGraph<NodeID_, DestID_, invert> MapSerializedGraph(std::string hints,
+                                                        bool verify = true) {
+    CheckSerializedTypes();
+    Timer t;
+    t.Start();
+    auto mapping = std::make_shared<MappedFile>(filename_, hints);
+    SGHeader header = ParseSGHeader(mapping->data(), mapping->size());
+    bool widen = CheckSGHeader(header);
+    bool directed = header.flags & kSGDirected;
+    verify &= header.version >= 2;
+    if (mapping->size() < static_cast<size_t>(SGFileBytes(header))) {
+      std::cout << "Truncated serialized graph " << filename_ << std::endl;
+      std::exit(-6);
+    }
+    SGOffset num_nodes = header.num_nodes, num_edges = header.num_edges;
+    bool in_place = false;
+    auto map_section = [&](int s) {
+      const char* pos = mapping->data() + header.sections[s].start;
+      if (verify)
+        CheckSection(header, s, pos);
+      return pos;
+    };
+    auto map_offsets = [&](int s) {
+      const char* pos = map_section(s);
+      CSROffsets index;
+      if (reinterpret_cast<uintptr_t>(pos) % alignof(SGOffset) == 0) {
+        index = CSROffsets(reinterpret_cast<const SGOffset*>(pos));
+        in_place = true;
+      } else {
+        pvector<SGOffset> offsets(num_nodes+1);
+        ParallelCopy(offsets.data(), pos, header.sections[s].num_bytes);
+        index = CSROffsets::Adopt(std::move(offsets));
+      }
+      return index;
+    };
+    auto map_neighs = [&](int s) {
+      const char* pos = map_section(s);
+      DestID_* neighs;
+      if (widen) {
+        const NarrowDestID* narrow = reinterpret_cast<const NarrowDestID*>(pos);
+        neighs = AllocateArray<DestID_>(num_edges);
+        #pragma omp parallel for
+        for (SGOffset e=0; e < num_edges; e++) {
+          NarrowDestID n;
+          std::memcpy(&n, narrow + e, sizeof(NarrowDestID));
+          neighs[e] = Widen(n);
+        }
+      } else if (reinterpret_cast<uintptr_t>(pos) % alignof(DestID_) == 0) {
+        neighs = reinterpret_cast<DestID_*>(const_cast<char*>(pos));
+        in_place = true;
+      } else {
+        neighs = AllocateArray<DestID_>(num_edges);
+        ParallelCopy(neighs, pos, header.sections[s].num_bytes);
+      }
+      return neighs;
+    };
+    CSROffsets index, inv_index;
+    DestID_ *neighs = nullptr, *inv_neighs = nullptr;
+    index = map_offsets(0);
+    neighs = map_neighs(1);
+    if (directed && invert) {
+      inv_index = map_offsets(2);
+      inv_neighs = map_neighs(3);
+    }
+    if (!in_place)
+      mapping.reset();
+    t.Stop();
+    PrintTime("Read Time", t.Seconds());
+    PrintLabel("Graph Arrays", in_place ? "mapped" : "copied");
+    if (directed)
+      return CSRGraph<NodeID_, DestID_, invert>(num_nodes, index, neighs,
+                                                inv_index, inv_neighs, mapping);
+    else
+      return CSRGraph<NodeID_, DestID_, invert>(num_nodes, index, neighs,
+                                                mapping);
+  }
+
+  // Layout of .csg: directed, edges (directed), nodes, then for outgoing
+  // (and incoming if directed) edges the number of encoded bytes, the byte
+  // offsets (nodes+1) and the encoded neighborhoods (see CompressedCSRGraph)
+  CompressedCSRGraph<NodeID_, invert> ReadCompressedGraph() {
+    if (!std::is_same<NodeID_, SGID>::value ||
+        !std::is_same<NodeID_, DestID_>::value) {
+      std::cout << ".csg only allowed for unweighted 32bit graphs" << std::endl;
+      std::exit(-5);
+    }
     std::ifstream file(filename_);
     if (!file.is_open()) {
       std::cout << "Couldn't open file " << filename_ << std::endl;
@@ -278,32 +738,34 @@ class Reader {
     t.Start();
     bool directed;
     SGOffset num_nodes, num_edges;
-    DestID_ **index = nullptr, **inv_index = nullptr;
-    DestID_ *neighs = nullptr, *inv_neighs = nullptr;
     file.read(reinterpret_cast<char*>(&directed), sizeof(bool));
     file.read(reinterpret_cast<char*>(&num_edges), sizeof(SGOffset));
     file.read(reinterpret_cast<char*>(&num_nodes), sizeof(SGOffset));
-    pvector<SGOffset> offsets(num_nodes+1);
-    neighs = new DestID_[num_edges];
     std::streamsize num_index_bytes = (num_nodes+1) * sizeof(SGOffset);
-    std::streamsize num_neigh_bytes = num_edges * sizeof(DestID_);
-    file.read(reinterpret_cast<char*>(offsets.data()), num_index_bytes);
-    file.read(reinterpret_cast<char*>(neighs), num_neigh_bytes);
-    index = CSRGraph<NodeID_, DestID_>::GenIndex(offsets, neighs);
-    if (directed && invert) {
-      inv_neighs = new DestID_[num_edges];
+    auto read_direction = [&](CSROffsets* index, uint8_t** bytes) {
+      SGOffset num_bytes;
+      file.read(reinterpret_cast<char*>(&num_bytes), sizeof(SGOffset));
+      pvector<SGOffset> offsets(num_nodes+1);
+      *bytes = AllocateArray<uint8_t>(num_bytes);
       file.read(reinterpret_cast<char*>(offsets.data()), num_index_bytes);
-      file.read(reinterpret_cast<char*>(inv_neighs), num_neigh_bytes);
-      inv_index = CSRGraph<NodeID_, DestID_>::GenIndex(offsets, inv_neighs);
+      file.read(reinterpret_cast<char*>(*bytes), num_bytes);
+      *index = CSROffsets::Adopt(std::move(offsets));
+    };
+    CSROffsets index, inv_index;
+    uint8_t *bytes = nullptr, *inv_bytes = nullptr;
+    read_direction(&index, &bytes);
+    if (directed && invert)
+      read_direction(&inv_index, &inv_bytes);
+    if (!file) {
+      std::cout << "Truncated compressed graph " << filename_ << std::endl;
+      std::exit(-6);
     }
     file.close();
     t.Stop();
     PrintTime("Read Time", t.Seconds());
-    if (directed)
-      return CSRGraph<NodeID_, DestID_, invert>(num_nodes, index, neighs,
-                                                inv_index, inv_neighs);
-    else
-      return CSRGraph<NodeID_, DestID_, invert>(num_nodes, index, neighs);
+    return CompressedCSRGraph<NodeID_, invert>(directed, num_nodes, num_edges,
+                                               index, bytes, inv_index,
+                                               inv_bytes);
   }
 };
 
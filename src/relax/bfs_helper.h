@@ -3,96 +3,69 @@
 #include <vector>
 #include <iostream>
 #include <atomic>
+#include <algorithm>
+#include <numeric>
+#include <omp.h>
 
 #include "queues/queues.h"
 #include "node.h"
 #include "../benchmark.h"
+#include "../bfs_verifier.h"
 #include "../graph.h"
 #include "../pvector.h"
+#include "../timer.h"
 
 using namespace std;
 
-// BFS verifier does a serial BFS from same source and asserts:
-// - parent[source] = source
-// - parent[v] = u  =>  depth[v] = depth[u] + 1 (except for source)
-// - parent[v] = u  => there is edge from u to v
-// - all vertices reachable from source have a parent
-bool BFSVerifier(const Graph &g, NodeID source,
-                 const pvector<NodeID> &parent)
+template <class GraphT_>
+void PrintBFSStats(const GraphT_ &g, const pvector<NodeID> &bfs_tree)
 {
-    pvector<int> depth(g.num_nodes(), -1);
-    depth[source] = 0;
-    vector<NodeID> to_visit;
-    to_visit.reserve(g.num_nodes());
-    to_visit.push_back(source);
-    for (auto it = to_visit.begin(); it != to_visit.end(); it++)
+    int64_t tree_size = 0;
+    int64_t n_edges = 0;
+    for (NodeID n : g.vertices())
     {
-        NodeID u = *it;
-        for (NodeID v : g.out_neigh(u))
+        if (bfs_tree[n] >= 0)
         {
-            if (depth[v] == -1)
-            {
-                depth[v] = depth[u] + 1;
-                to_visit.push_back(v);
-            }
+            n_edges += g.out_degree(n);
+            tree_size++;
         }
     }
-    for (NodeID u : g.vertices())
+    cout << "BFS Tree has " << tree_size << " nodes and ";
+    cout << n_edges << " edges" << endl;
+}
+
+#ifdef LEAF_DEGREE
+// A vertex that just won its CAS at depth needs no expansion if it has at most
+// LEAF_DEGREE neighbors and none of them can be improved through it (e.g. a
+// degree-1 vertex whose only neighbor is its parent). Depths only decrease, so
+// the check stays valid, and if the vertex itself is improved later the thread
+// winning that CAS checks it again.
+inline bool IsSettledLeaf(const Graph &g, const pvector<Node> &parent_array,
+                          NodeID node_id, uint32_t depth)
+{
+    if (g.out_degree(node_id) > LEAF_DEGREE)
     {
-        if ((depth[u] != -1) && (parent[u] != -1))
-        {
-            if (u == source)
-            {
-                if (!((parent[u] == u) && (depth[u] == 0)))
-                {
-                    cout << "Source wrong" << endl;
-                    return false;
-                }
-                continue;
-            }
-            bool parent_found = false;
-            for (NodeID v : g.in_neigh(u))
-            {
-                if (v == parent[u])
-                {
-                    if (depth[v] != depth[u] - 1)
-                    {
-                        cout << "Wrong depths for " << u << " & " << v << endl;
-                        return false;
-                    }
-                    parent_found = true;
-                    break;
-                }
-            }
-            if (!parent_found)
-            {
-                cout << "Couldn't find edge from " << parent[u] << " to " << u << endl;
-                return false;
-            }
-        }
-        else if (depth[u] != parent[u])
+        return false;
+    }
+    for (NodeID neighbor_id : g.out_neigh(node_id))
+    {
+        if (parent_array[neighbor_id].depth > depth + 1)
         {
-            cout << "Reachability mismatch" << endl;
             return false;
         }
     }
     return true;
 }
+#endif
 
-void PrintBFSStats(const Graph &g, const pvector<NodeID> &bfs_tree)
-{
-    int64_t tree_size = 0;
-    int64_t n_edges = 0;
-    for (NodeID n : g.vertices())
-    {
-        if (bfs_tree[n] >= 0)
-        {
-            n_edges += g.out_degree(n);
-            tree_size++;
-        }
+// Prints the largest and the average time a thread spent waiting for work
+void PrintIdleTimes(const std::vector<double> &idle_seconds) {
+    if (idle_seconds.empty()) {
+        return;
     }
-    cout << "BFS Tree has " << tree_size << " nodes and ";
-    cout << n_edges << " edges" << endl;
+    double total = std::accumulate(idle_seconds.begin(), idle_seconds.end(), 0.0);
+    PrintTime("Idle time max", *std::max_element(idle_seconds.begin(), idle_seconds.end()));
+    PrintTime("Idle time avg", total / idle_seconds.size());
 }
 
 #pragma once
@@ -104,18 +77,135 @@ void PrintBFSStats(const Graph &g, const pvector<NodeID> &bfs_tree)
 #define PAUSE void(0)
 #endif
 
+#if defined(IDLE_FUTEX) && !defined(IDLE_BACKOFF)
+#define IDLE_BACKOFF 1024
+#endif
+
+#ifdef IDLE_FUTEX
+#ifndef __linux__
+#error "IDLE_FUTEX requires futex support (Linux)"
+#endif
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace termination_detection {
 
+// Number of threads that failed to find work, a single shared counter
+class FlatCounter {
+    int num_threads_;
+    std::atomic_int count_{0};
+
+   public:
+    explicit FlatCounter(int num_threads) : num_threads_{num_threads} {}
+
+    void enter() { count_.fetch_add(1, std::memory_order_relaxed); }
+    void leave() { count_.fetch_sub(1, std::memory_order_relaxed); }
+    bool all() const { return count_.load(std::memory_order_relaxed) >= num_threads_; }
+};
+
+// Same as FlatCounter, but threads count in the line of their group of
+// TERMINATION_GROUP_SIZE consecutive thread ids (one socket when threads are
+// pinned in order) and only the thread completing or breaking up a full group
+// touches the root. The root can lag behind the groups for a moment, which
+// is fine as it only gates the exact idle count in TerminationDetection.
+class HierarchicalCounter {
+    struct alignas(64) Group {
+        std::atomic_int count{0};
+        int size = 0;
+    };
+    int group_size_;
+    std::vector<Group> groups_;
+    alignas(64) std::atomic_int full_groups_{0};
+
+    Group &group() { return groups_[omp_get_thread_num() / group_size_]; }
+
+   public:
+    HierarchicalCounter(int num_threads, int group_size)
+        : group_size_{group_size}, groups_((num_threads + group_size - 1) / group_size) {
+        for (int thread_id = 0; thread_id < num_threads; thread_id++) {
+            groups_[thread_id / group_size].size++;
+        }
+    }
+
+    void enter() {
+        Group &g = group();
+        if (g.count.fetch_add(1, std::memory_order_relaxed) + 1 == g.size) {
+            full_groups_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void leave() {
+        Group &g = group();
+        if (g.count.fetch_sub(1, std::memory_order_relaxed) == g.size) {
+            full_groups_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool all() const {
+        return full_groups_.load(std::memory_order_relaxed) >= static_cast<int>(groups_.size());
+    }
+};
+
 // Taken from https://github.com/marvinwilliams/multiqueue_experiments
+//
+// Optional idle waiting (both off by default, which keeps the original spin):
+// - IDLE_BACKOFF=n: between failed attempts an idle thread spins PAUSE for an
+//   exponentially growing number of iterations, capped at n
+// - IDLE_FUTEX=us: once the backoff is capped, the thread parks on a futex for
+//   at most us microseconds. A thread coming back to repeat() for more work
+//   (after publishing the output of its last batch) wakes one sleeper, and
+//   starting termination wakes all of them. The timeout bounds the cost of a
+//   wake-up racing with going to sleep. Timeouts of a second or more are
+//   split into seconds and nanoseconds, as FUTEX_WAIT rejects tv_nsec >= 1e9.
+// In DEBUG builds the time each thread spends waiting for work is recorded.
+//
+// The threads without work are counted by NoWorkCounter, which is touched on
+// every failed attempt. The idle count is only touched once all threads are
+// out of work and stays a single exact counter.
 
-class TerminationDetection {
+template <typename NoWorkCounter>
+class BasicTerminationDetection {
     int num_threads_;
     std::atomic_int idle_count_{0};
-    std::atomic_int no_work_count_{0};
+    NoWorkCounter no_work_;
+    #ifdef IDLE_FUTEX
+    std::atomic_int sleepers_{0};
+    std::atomic<uint32_t> wake_epoch_{0};
+    #endif
+    #ifdef DEBUG
+    struct alignas(64) IdleTime {
+        double seconds = 0;
+    };
+    std::vector<IdleTime> idle_times_;
+    #endif
+
+    #ifdef IDLE_FUTEX
+    void wake(int num_waiters) {
+        wake_epoch_.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&wake_epoch_),
+                FUTEX_WAKE_PRIVATE, num_waiters, nullptr, nullptr, 0);
+    }
+
+    void sleep(uint32_t epoch) {
+        struct timespec timeout = {IDLE_FUTEX / 1000000,
+                                   (IDLE_FUTEX % 1000000) * 1000L};
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&wake_epoch_),
+                FUTEX_WAIT_PRIVATE, epoch, &timeout, nullptr, 0);
+    }
+    #endif
 
     bool should_terminate() {
+        #ifdef IDLE_FUTEX
+        if (sleepers_.load(std::memory_order_relaxed) > 0) {
+            wake(INT_MAX);
+        }
+        #endif
         idle_count_.fetch_add(1, std::memory_order_relaxed);
-        while (no_work_count_.load(std::memory_order_relaxed) >= num_threads_) {
+        while (no_work_.all()) {
             if (idle_count_.load(std::memory_order_relaxed) >= num_threads_) {
                 return true;
             }
@@ -125,27 +215,103 @@ class TerminationDetection {
         return false;
     }
 
+    template <typename F>
+    bool wait_for_work(F&& f) {
+        #ifdef IDLE_BACKOFF
+        int backoff = 1;
+        #endif
+        while (!f()) {
+            if (no_work_.all()) {
+                if (should_terminate()) {
+                    return false;
+                }
+            }
+            #ifdef IDLE_BACKOFF
+            if (backoff < IDLE_BACKOFF) {
+                for (int i = 0; i < backoff; i++) {
+                    PAUSE;
+                }
+                backoff *= 2;
+                continue;
+            }
+            #ifdef IDLE_FUTEX
+            uint32_t epoch = wake_epoch_.load(std::memory_order_acquire);
+            sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            bool found_work = f();
+            if (!found_work && !no_work_.all()) {
+                sleep(epoch);
+            }
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+            if (found_work) {
+                return true;
+            }
+            #else
+            for (int i = 0; i < backoff; i++) {
+                PAUSE;
+            }
+            #endif
+            #endif
+        }
+        return true;
+    }
+
    public:
-    explicit TerminationDetection(int num_threads) : num_threads_{num_threads} {
+    template <typename... Args>
+    explicit BasicTerminationDetection(int num_threads, Args... args)
+        : num_threads_{num_threads}, no_work_{num_threads, args...} {
+        #ifdef DEBUG
+        idle_times_.resize(num_threads);
+        #endif
     }
 
     template <typename F>
     bool repeat(F&& f) {
+        #ifdef IDLE_FUTEX
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed) > 0) {
+            wake(1);
+        }
+        #endif
         if (f()) {
             return true;
         }
-        no_work_count_.fetch_add(1, std::memory_order_relaxed);
-        while (!f()) {
-            if (no_work_count_.load(std::memory_order_relaxed) >= num_threads_) {
-                if (should_terminate()) {
-                    return false;
-                }
-            }
+        #ifdef DEBUG
+        Timer idle_timer;
+        idle_timer.Start();
+        #endif
+        no_work_.enter();
+        bool found_work = wait_for_work(f);
+        #ifdef DEBUG
+        idle_timer.Stop();
+        idle_times_[omp_get_thread_num()].seconds += idle_timer.Seconds();
+        #endif
+        if (!found_work) {
+            return false;
         }
-        no_work_count_.fetch_sub(1, std::memory_order_relaxed);
+        no_work_.leave();
         return true;
     }
+
+    #ifdef DEBUG
+    std::vector<double> idle_seconds() const {
+        std::vector<double> seconds;
+        for (const IdleTime &idle_time : idle_times_) {
+            seconds.push_back(idle_time.seconds);
+        }
+        return seconds;
+    }
+    #endif
+};
+
+#ifdef TERMINATION_GROUP_SIZE
+class TerminationDetection : public BasicTerminationDetection<HierarchicalCounter> {
+   public:
+    explicit TerminationDetection(int num_threads)
+        : BasicTerminationDetection(num_threads, TERMINATION_GROUP_SIZE) {}
 };
+#else
+using TerminationDetection = BasicTerminationDetection<FlatCounter>;
+#endif
 
 }  // namespace termination_detection
 
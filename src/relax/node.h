@@ -1,13 +1,27 @@
 #pragma once
 #include <cstdint>
 
-#define MAX_DEPTH 0xFFFFFFFF
-
 #ifndef BATCH_SIZE
     #define BATCH_SIZE 8
 #endif
 typedef std::array<NodeID, BATCH_SIZE> NodeIdArray;
 
+#if NODEID_BITS == 64
+// Packs a 40-bit parent and a 24-bit depth, so Node (and its CAS) stays 8 bytes
+#define MAX_DEPTH 0xFFFFFF
+
+struct Node
+{
+    NodeID parent : 40;
+    uint32_t depth : 24;
+
+    Node() : parent(-1), depth(MAX_DEPTH) {}
+
+    Node(NodeID parent, uint32_t depth) : parent(parent), depth(depth) {}
+};
+#else
+#define MAX_DEPTH 0xFFFFFFFF
+
 struct Node
 {
     NodeID parent;
@@ -17,6 +31,7 @@ struct Node
 
     Node(NodeID parent, uint32_t depth) : parent(parent), depth(depth) {}
 };
+#endif
 
 // Function to perform CAS on a 64-bit struct
 bool compare_and_swap(Node &x, Node old_val, Node new_val)
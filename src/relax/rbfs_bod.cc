@@ -23,6 +23,8 @@ using json = nlohmann::json;
 std::vector<uint64_t> source_node_vec;
 std::vector<uint64_t> nodes_visited_vec;
 std::vector<uint64_t> nodes_revisited_vec;
+std::vector<uint64_t> enqueues_saved_vec;
+std::vector<std::vector<double>> idle_times_vec;
 
 pvector<NodeID> ConcurrentBFS(const Graph &g, NodeID source_id, bool logging_enabled = false, bool structured_output = false)
 {
@@ -31,13 +33,16 @@ pvector<NodeID> ConcurrentBFS(const Graph &g, NodeID source_id, bool logging_ena
     uint64_t nodes_revisited_total = 0;
     uint64_t nodes_visited_local = 0;
     uint64_t nodes_visited_total = 0;
+    uint64_t enqueues_saved_local = 0;
+    uint64_t enqueues_saved_total = 0;
     if (logging_enabled) {
         PrintAligned("Source", source_id);
     }
     source_node_vec.push_back(source_id);
     #endif
 
-    int thread_id = omp_get_thread_num();
+    // Seeds the queue, only SEQ_START and the queues that take a thread id read it
+    [[maybe_unused]] int thread_id = omp_get_thread_num();
 
     pvector<Node> parent_array = pvector<Node>(g.num_nodes());
     QUEUE(NodeIdArray);
@@ -57,20 +62,21 @@ pvector<NodeID> ConcurrentBFS(const Graph &g, NodeID source_id, bool logging_ena
     termination_detection::TerminationDetection termination_detection(omp_get_max_threads());
 
     #ifdef DEBUG
-    #pragma omp parallel private(thread_id, nodes_revisited_local, nodes_visited_local)
+    #pragma omp parallel private(nodes_revisited_local, nodes_visited_local, enqueues_saved_local)
     #endif
     #ifndef DEBUG
-    #pragma omp parallel private(thread_id)
+    #pragma omp parallel
     #endif
     {
         NodeIdArray consumer_batch;
         NodeIdArray producer_batch;
         NodeIdArray backup_batch;
         
-        thread_id = omp_get_thread_num();
+        [[maybe_unused]] int thread_id = omp_get_thread_num();
         #ifdef DEBUG
         nodes_revisited_local = 0;
         nodes_visited_local = 0;
+        enqueues_saved_local = 0;
         #endif
 
         bool do_backup = false;
@@ -105,6 +111,14 @@ search_neighbors:
                         #endif
                         Node updated_node = {node_id, new_depth};
                         if (compare_and_swap(parent_array[neighbor_id], neighbor, updated_node)) {
+                            #ifdef LEAF_DEGREE
+                            if (IsSettledLeaf(g, parent_array, neighbor_id, new_depth)) {
+                                #ifdef DEBUG
+                                enqueues_saved_local += 1;
+                                #endif
+                                break;
+                            }
+                            #endif
                             producer_batch[producer_counter] = neighbor_id;
                             if (producer_counter >= BATCH_SIZE - 1) {
                                 ENQUEUE(producer_batch);
@@ -174,6 +188,8 @@ search_neighbors:
         nodes_revisited_total += nodes_revisited_local;
         #pragma omp atomic
         nodes_visited_total += nodes_visited_local;
+        #pragma omp atomic
+        enqueues_saved_total += enqueues_saved_local;
         #endif
     }
 
@@ -187,9 +203,13 @@ search_neighbors:
         PrintAligned("Seq-Start", SEQ_START);
         PrintAligned("Nodes visited", nodes_visited_total);
         PrintAligned("Nodes revisited", nodes_revisited_total);
+        PrintAligned("Enqueues saved", enqueues_saved_total);
+        PrintIdleTimes(termination_detection.idle_seconds());
     }
     nodes_visited_vec.push_back(nodes_visited_total);
     nodes_revisited_vec.push_back(nodes_revisited_total);
+    enqueues_saved_vec.push_back(enqueues_saved_total);
+    idle_times_vec.push_back(termination_detection.idle_seconds());
     #endif
     return result;
 }
@@ -213,24 +233,32 @@ int main(int argc, char *argv[]) {
     };
 
     SourcePicker<Graph> vsp(g, cli.start_vertex());
-    auto VerifierBound = [&vsp](const Graph &g, const pvector<NodeID> &parent)
+    auto VerifierBound = [&vsp, &cli](const Graph &g, const pvector<NodeID> &parent)
     {
-        return BFSVerifier(g, vsp.PickNext(), parent);
+        return BFSVerifier(g, vsp.PickNext(), parent, cli.verify_samples());
     };
 
     PrintAligned("Threads", omp_get_max_threads());
     PrintLabel("Queue", QUEUE_TYPE);
+    #ifdef LEAF_DEGREE
+    PrintAligned("Leaf Degree", LEAF_DEGREE);
+    #endif
     PrintAligned("Batch Size", BATCH_SIZE);
-    auto structured_output = BenchmarkKernelWithStructuredOutput(cli, g, BFSBound, PrintBFSStats, VerifierBound);
+    auto structured_output = BenchmarkKernelWithStructuredOutput(cli, g, BFSBound, PrintBFSStats<Graph>, VerifierBound);
 
     if (cli.structured_output()) {
         auto runs = structured_output["run_details"];
         structured_output["queue"] = QUEUE_TYPE;
         structured_output["seq_start"] = SEQ_START;
+        #ifdef LEAF_DEGREE
+        structured_output["leaf_degree"] = LEAF_DEGREE;
+        #endif
         for (size_t i = 0; i < source_node_vec.size(); i++) {
             auto run = runs[i];
             run["nodes_visited"] = nodes_visited_vec[i];
             run["nodes_revisited"] = nodes_revisited_vec[i];
+            run["enqueues_saved"] = enqueues_saved_vec[i];
+            run["idle_times"] = idle_times_vec[i];
             run["source"] = source_node_vec[i];
             runs[i] = run;
         }
@@ -27,53 +27,10 @@ using json = nlohmann::json;
 std::vector<uint64_t> source_node_vec;
 std::vector<uint64_t> nodes_visited_vec;
 std::vector<uint64_t> nodes_revisited_vec;
+std::vector<uint64_t> enqueues_saved_vec;
+std::vector<std::vector<double>> idle_times_vec;
 typedef std::array<NodeID, BATCH_SIZE> NodeIdArray;
 
-template <typename Q>
-void SequentialStart(const Graph &g, pvector<Node> &parent_array, Q &queue, NodeID source_id, int thread_id, int nr_iterations) {
-    std::queue<NodeID> seq_queue;
-    seq_queue.push(source_id);
-    int counter = 0;
-    NodeID node_id;
-    while (!seq_queue.empty() && counter < nr_iterations) {
-        node_id = seq_queue.front();
-        seq_queue.pop();
-        g.out_neigh(node_id);
-        for (NodeID neighbor_id : g.out_neigh(node_id)) {
-            NodeID curr_parent = parent_array[neighbor_id].parent;
-            if (curr_parent < 0) {
-                uint32_t curr_depth = parent_array[node_id].depth;
-                uint32_t new_depth = curr_depth + 1;
-                Node updated_node = {node_id, new_depth};
-                parent_array[neighbor_id] = updated_node;
-                seq_queue.push(neighbor_id);
-            }
-        }
-        counter++;
-    }
-
-    uint8_t enqueue_counter = 0;
-    NodeIdArray enqueue_array;
-    // transfer to concurrent queue
-    while (!seq_queue.empty()) {
-        node_id = seq_queue.front();
-        seq_queue.pop();
-        enqueue_array[enqueue_counter] = node_id;
-        if (enqueue_counter >= BATCH_SIZE - 1) {
-            ENQUEUE(enqueue_array);
-            enqueue_array = NodeIdArray();
-            enqueue_counter = 0;
-        } else {
-            enqueue_counter++;
-        }
-    }
-
-    if (enqueue_counter > 0) {
-        enqueue_array[enqueue_counter] = -1;
-        ENQUEUE(enqueue_array);
-    }
-}
-
 pvector<NodeID> ConcurrentBFS(const Graph &g, NodeID source_id, bool logging_enabled = false, bool structured_output = false)
 {
     #ifdef DEBUG
@@ -81,13 +38,16 @@ pvector<NodeID> ConcurrentBFS(const Graph &g, NodeID source_id, bool logging_ena
     uint64_t nodes_revisited_total = 0;
     uint64_t nodes_visited_local = 0;
     uint64_t nodes_visited_total = 0;
+    uint64_t enqueues_saved_local = 0;
+    uint64_t enqueues_saved_total = 0;
     if (logging_enabled) {
         PrintAligned("Source", source_id);
     }
     source_node_vec.push_back(source_id);
     #endif
 
-    int thread_id = omp_get_thread_num();
+    // Seeds the queue, only SEQ_START and the queues that take a thread id read it
+    [[maybe_unused]] int thread_id = omp_get_thread_num();
 
     pvector<Node> parent_array = pvector<Node>(g.num_nodes());
     QUEUE(NodeIdArray);
@@ -107,20 +67,21 @@ pvector<NodeID> ConcurrentBFS(const Graph &g, NodeID source_id, bool logging_ena
     termination_detection::TerminationDetection termination_detection(omp_get_max_threads());
 
     #ifdef DEBUG
-    #pragma omp parallel private(thread_id, nodes_revisited_local, nodes_visited_local)
+    #pragma omp parallel private(nodes_revisited_local, nodes_visited_local, enqueues_saved_local)
     #endif
     #ifndef DEBUG
-    #pragma omp parallel private(thread_id)
+    #pragma omp parallel
     #endif
     {
         NodeIdArray dequeue_array;
         NodeIdArray enqueue_array;
         NodeIdArray backup_array;
         
-        thread_id = omp_get_thread_num();
+        [[maybe_unused]] int thread_id = omp_get_thread_num();
         #ifdef DEBUG
         nodes_revisited_local = 0;
         nodes_visited_local = 0;
+        enqueues_saved_local = 0;
         #endif
 
         bool do_backup = false;
@@ -155,6 +116,14 @@ search_neighbors:
                         #endif
                         Node updated_node = {node_id, new_depth};
                         if (compare_and_swap(parent_array[neighbor_id], neighbor, updated_node)) {
+                            #ifdef LEAF_DEGREE
+                            if (IsSettledLeaf(g, parent_array, neighbor_id, new_depth)) {
+                                #ifdef DEBUG
+                                enqueues_saved_local += 1;
+                                #endif
+                                break;
+                            }
+                            #endif
                             enqueue_array[enqueue_counter] = neighbor_id;
                             if (enqueue_counter >= BATCH_SIZE - 1) {
                                 ENQUEUE(enqueue_array);
@@ -208,6 +177,8 @@ search_neighbors:
         nodes_revisited_total += nodes_revisited_local;
         #pragma omp atomic
         nodes_visited_total += nodes_visited_local;
+        #pragma omp atomic
+        enqueues_saved_total += enqueues_saved_local;
         #endif
     }
 
@@ -221,9 +192,13 @@ search_neighbors:
         PrintAligned("Seq-Start", SEQ_START);
         PrintAligned("Nodes visited", nodes_visited_total);
         PrintAligned("Nodes revisited", nodes_revisited_total);
+        PrintAligned("Enqueues saved", enqueues_saved_total);
+        PrintIdleTimes(termination_detection.idle_seconds());
     }
     nodes_visited_vec.push_back(nodes_visited_total);
     nodes_revisited_vec.push_back(nodes_revisited_total);
+    enqueues_saved_vec.push_back(enqueues_saved_total);
+    idle_times_vec.push_back(termination_detection.idle_seconds());
     #endif
     return result;
 }
@@ -247,24 +222,32 @@ int main(int argc, char *argv[]) {
     };
 
     SourcePicker<Graph> vsp(g, cli.start_vertex());
-    auto VerifierBound = [&vsp](const Graph &g, const pvector<NodeID> &parent)
+    auto VerifierBound = [&vsp, &cli](const Graph &g, const pvector<NodeID> &parent)
     {
-        return BFSVerifier(g, vsp.PickNext(), parent);
+        return BFSVerifier(g, vsp.PickNext(), parent, cli.verify_samples());
     };
 
     PrintAligned("Threads", omp_get_max_threads());
     PrintLabel("Queue", QUEUE_TYPE);
+    #ifdef LEAF_DEGREE
+    PrintAligned("Leaf Degree", LEAF_DEGREE);
+    #endif
     PrintAligned("Batch Size", BATCH_SIZE);
-    auto structured_output = BenchmarkKernelWithStructuredOutput(cli, g, BFSBound, PrintBFSStats, VerifierBound);
+    auto structured_output = BenchmarkKernelWithStructuredOutput(cli, g, BFSBound, PrintBFSStats<Graph>, VerifierBound);
 
     if (cli.structured_output()) {
         auto runs = structured_output["run_details"];
         structured_output["queue"] = QUEUE_TYPE;
         structured_output["seq_start"] = SEQ_START;
+        #ifdef LEAF_DEGREE
+        structured_output["leaf_degree"] = LEAF_DEGREE;
+        #endif
         for (size_t i = 0; i < source_node_vec.size(); i++) {
             auto run = runs[i];
             run["nodes_visited"] = nodes_visited_vec[i];
             run["nodes_revisited"] = nodes_revisited_vec[i];
+            run["enqueues_saved"] = enqueues_saved_vec[i];
+            run["idle_times"] = idle_times_vec[i];
             run["source"] = source_node_vec[i];
             runs[i] = run;
         }
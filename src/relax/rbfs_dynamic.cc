@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <random>
+
+#include "../benchmark.h"
+#include "../builder.h"
+#include "../command_line.h"
+#include "../dynamic_graph.h"
+#include "../generator.h"
+#include "../graph.h"
+#include "../platform_atomics.h"
+#include "../pvector.h"
+#include "../timer.h"
+#include "../util.h"
+#include "../json.h"
+#include "bfs_helper.h"
+#include "node.h"
+#include "queues/queues.h"
+#include <boost/lockfree/queue.hpp>
+#include <omp.h>
+
+// Keeps a BFS tree up to date while batches of edges are deleted and
+// inserted. Every trial deletes a batch of random edges of a DynamicGraph and
+// then inserts a batch of uniformly random edges, and repairs the tree after
+// each batch from the changed region only:
+// - Deleting a tree edge resets the subtree below it, found by following
+//   tree edges down from the deleted ones. Vertices keeping their path to
+//   the source keep their (exact) depths, so every reset vertex is attached
+//   again to its shallowest in-neighbor still in the tree and the usual CAS
+//   relaxation propagates from there.
+// - As inserting only shrinks depths, the endpoints an inserted edge makes
+//   shallower seed the relaxed queue.
+// The trial time is the time of the updates and repairs, random batches are
+// generated outside of it.
+
+using json = nlohmann::json;
+typedef DynamicGraph<NodeID, Graph> DGraph;
+typedef EdgePair<NodeID, NodeID> Edge;
+
+std::vector<double> insert_times_vec;
+std::vector<double> repair_times_vec;
+std::vector<int64_t> inserted_edges_vec;
+std::vector<double> delete_times_vec;
+std::vector<double> delete_repair_times_vec;
+std::vector<int64_t> deleted_edges_vec;
+std::vector<int64_t> reset_vertices_vec;
+
+// Runs visit(node_id, push) on every vertex pushed, starting with the ones
+// seed(push) pushes in every thread, until the relaxed queue runs empty
+template <typename SeedFunc, typename VisitFunc>
+void ProcessQueue(SeedFunc seed, VisitFunc visit) {
+    QUEUE(NodeID);
+
+    termination_detection::TerminationDetection termination_detection(omp_get_max_threads());
+
+    #pragma omp parallel
+    {
+        NodeID node_id;
+        // Only the queues that take a thread id read it
+        [[maybe_unused]] int thread_id = omp_get_thread_num();
+        auto push = [&](NodeID pushed_id) {
+            ENQUEUE(pushed_id);
+        };
+
+        // Threads count as busy until their first repeat(), so seeding here is safe
+        seed(push);
+
+        while (termination_detection.repeat([&]() {
+            return DEQUEUE(node_id);
+        })) {
+            visit(node_id, push);
+        }
+    }
+}
+
+// Lowers node_id to depth new_depth under parent, true if this thread did
+inline bool Improve(pvector<Node> &parent_array, NodeID parent, NodeID node_id, uint32_t new_depth) {
+    Node node = parent_array[node_id];
+    while (new_depth < node.depth) {
+        Node updated_node = {parent, new_depth};
+        if (compare_and_swap(parent_array[node_id], node, updated_node)) {
+            return true;
+        }
+        node = parent_array[node_id];
+    }
+    return false;
+}
+
+// Seeds with the edge (u, v) if it makes v shallower
+inline bool ImproveThrough(pvector<Node> &parent_array, NodeID u, NodeID v) {
+    uint32_t depth = parent_array[u].depth;
+    return (depth != MAX_DEPTH) && Improve(parent_array, u, v, depth + 1);
+}
+
+// Resets v if its tree edge comes from u, true if this thread did
+inline bool ResetChild(pvector<Node> &parent_array, NodeID u, NodeID v) {
+    Node node = parent_array[v];
+    return (node.parent == u) && (u != v) && compare_and_swap(parent_array[v], node, Node());
+}
+
+// Relaxed BFS from the vertices seed(push) pushes, starting from the depths
+// already in parent_array
+template <typename SeedFunc>
+void RelaxedBFS(const DGraph &g, pvector<Node> &parent_array, SeedFunc seed) {
+    ProcessQueue(seed, [&](NodeID node_id, auto &push) {
+        uint32_t new_depth = parent_array[node_id].depth + 1;
+        for (NodeID neighbor_id : g.out_neigh(node_id)) {
+            if (Improve(parent_array, node_id, neighbor_id, new_depth)) {
+                push(neighbor_id);
+            }
+        }
+    });
+}
+
+void RepairInsertions(const DGraph &g, pvector<Node> &parent_array, const pvector<Edge> &batch) {
+    RelaxedBFS(g, parent_array, [&](auto &push) {
+        #pragma omp for nowait
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (ImproveThrough(parent_array, batch[i].u, batch[i].v)) {
+                push(batch[i].v);
+            }
+            if (!g.directed() && ImproveThrough(parent_array, batch[i].v, batch[i].u)) {
+                push(batch[i].u);
+            }
+        }
+    });
+}
+
+// Resets the subtrees below the deleted tree edges and reattaches them,
+// returns the number of reset vertices
+int64_t RepairDeletions(const DGraph &g, pvector<Node> &parent_array, const pvector<Edge> &batch) {
+    std::vector<std::vector<NodeID>> reset_by_thread(omp_get_max_threads());
+    ProcessQueue([&](auto &push) {
+        #pragma omp for nowait
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (ResetChild(parent_array, batch[i].u, batch[i].v)) {
+                push(batch[i].v);
+            }
+            if (!g.directed() && ResetChild(parent_array, batch[i].v, batch[i].u)) {
+                push(batch[i].u);
+            }
+        }
+    }, [&](NodeID node_id, auto &push) {
+        reset_by_thread[omp_get_thread_num()].push_back(node_id);
+        for (NodeID child_id : g.out_neigh(node_id)) {
+            if (ResetChild(parent_array, node_id, child_id)) {
+                push(child_id);
+            }
+        }
+    });
+    std::vector<NodeID> reset;
+    for (const std::vector<NodeID> &thread_reset : reset_by_thread) {
+        reset.insert(reset.end(), thread_reset.begin(), thread_reset.end());
+    }
+
+    RelaxedBFS(g, parent_array, [&](auto &push) {
+        #pragma omp for nowait schedule(dynamic, 64)
+        for (size_t i = 0; i < reset.size(); i++) {
+            NodeID node_id = reset[i];
+            NodeID best_parent = -1;
+            uint32_t best_depth = MAX_DEPTH;
+            for (NodeID neighbor_id : g.in_neigh(node_id)) {
+                uint32_t depth = parent_array[neighbor_id].depth;
+                if (depth < best_depth) {
+                    best_depth = depth;
+                    best_parent = neighbor_id;
+                }
+            }
+            if ((best_parent != -1) && Improve(parent_array, best_parent, node_id, best_depth + 1)) {
+                push(node_id);
+            }
+        }
+    });
+    return reset.size();
+}
+
+// Uniformly random edges, seeded apart from the graph generator
+pvector<Edge> RandomEdges(int64_t num_nodes, int64_t batch_size, int64_t batch_id) {
+    const int64_t block_size = 1 << 16;
+    pvector<Edge> batch(batch_size);
+    #pragma omp parallel
+    {
+        std::mt19937_64 rng;
+        UniDist<NodeID, std::mt19937_64> udist(num_nodes - 1, rng);
+        #pragma omp for
+        for (int64_t block = 0; block < batch_size; block += block_size) {
+            std::seed_seq seeds{kRandSeed, batch_id, block / block_size, int64_t(0)};
+            rng.seed(seeds);
+            for (int64_t e = block; e < std::min(block + block_size, batch_size); e++) {
+                batch[e] = Edge(udist(), udist());
+            }
+        }
+    }
+    return batch;
+}
+
+// Uniformly random edges of g, found through the prefix sums of the degrees,
+// at most as many as g has left
+pvector<Edge> RandomExistingEdges(const DGraph &g, int64_t batch_size, int64_t batch_id) {
+    batch_size = std::min(batch_size, g.num_edges());
+    pvector<int64_t> offsets(g.num_nodes() + 1);
+    #pragma omp parallel for
+    for (NodeID n = 0; n < g.num_nodes(); n++) {
+        offsets[n] = g.out_degree(n);
+    }
+    int64_t total = 0;
+    for (NodeID n = 0; n < g.num_nodes(); n++) {
+        int64_t degree = offsets[n];
+        offsets[n] = total;
+        total += degree;
+    }
+    offsets[g.num_nodes()] = total;
+    if (total == 0) {
+        return pvector<Edge>(0);
+    }
+    const int64_t block_size = 1 << 16;
+    pvector<Edge> batch(batch_size);
+    #pragma omp parallel
+    {
+        std::mt19937_64 rng;
+        UniDist<int64_t, std::mt19937_64> udist(total - 1, rng);
+        #pragma omp for
+        for (int64_t block = 0; block < batch_size; block += block_size) {
+            std::seed_seq seeds{kRandSeed, batch_id, block / block_size, int64_t(1)};
+            rng.seed(seeds);
+            for (int64_t e = block; e < std::min(block + block_size, batch_size); e++) {
+                int64_t index = udist();
+                NodeID u = std::upper_bound(offsets.begin(), offsets.end(), index) - offsets.begin() - 1;
+                index -= offsets[u];
+                for (NodeID v : g.out_neigh(u)) {
+                    if (index-- == 0) {
+                        batch[e] = Edge(u, v);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return batch;
+}
+
+pvector<NodeID> Parents(const pvector<Node> &parent_array) {
+    pvector<NodeID> result(parent_array.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < parent_array.size(); i++) {
+        result[i] = parent_array[i].parent;
+    }
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    CLDynamicBFSApp cli(argc, argv, "Dynamic Relaxed BFS");
+
+    if (!cli.ParseArgs()) {
+        printf("Exiting");
+        return -1;
+    }
+    Builder b(cli);
+    DGraph g(b.MakeGraph());
+
+    // One tree, repaired after every batch
+    SourcePicker<DGraph> sp(g, cli.start_vertex());
+    NodeID source_id = sp.PickNext();
+    pvector<Node> parent_array(g.num_nodes());
+    parent_array[source_id] = {source_id, 0};
+    Timer t;
+    t.Start();
+    RelaxedBFS(g, parent_array, [&](auto &push) {
+        if (omp_get_thread_num() == 0) {
+            push(source_id);
+        }
+    });
+    t.Stop();
+    PrintAligned("Source", source_id);
+    PrintTime("Initial BFS Time", t.Seconds());
+    double initial_seconds = t.Seconds();
+
+    // Only the updates and repairs are timed, not generating the batches or
+    // copying out the parents
+    int64_t batch_id = 0;
+    double update_seconds = 0;
+    auto UpdateBound = [&](const DGraph &) {
+        Timer update_timer;
+        update_seconds = 0;
+        if (cli.delete_size() > 0) {
+            pvector<Edge> batch = RandomExistingEdges(g, cli.delete_size(), batch_id);
+            update_timer.Start();
+            int64_t deleted = g.DeleteEdges(batch);
+            update_timer.Stop();
+            PrintAligned("Deleted Edges", deleted);
+            PrintTime("Delete Time", update_timer.Seconds());
+            delete_times_vec.push_back(update_timer.Seconds());
+            update_seconds += update_timer.Seconds();
+            deleted_edges_vec.push_back(deleted);
+            update_timer.Start();
+            int64_t reset = RepairDeletions(g, parent_array, batch);
+            update_timer.Stop();
+            PrintAligned("Reset Vertices", reset);
+            PrintTime("Delete Repair Time", update_timer.Seconds());
+            delete_repair_times_vec.push_back(update_timer.Seconds());
+            update_seconds += update_timer.Seconds();
+            reset_vertices_vec.push_back(reset);
+        }
+        pvector<Edge> batch = RandomEdges(g.num_nodes(), cli.batch_size(), batch_id++);
+        update_timer.Start();
+        int64_t inserted = g.InsertEdges(batch);
+        update_timer.Stop();
+        PrintAligned("Inserted Edges", inserted);
+        PrintTime("Insert Time", update_timer.Seconds());
+        insert_times_vec.push_back(update_timer.Seconds());
+        update_seconds += update_timer.Seconds();
+        inserted_edges_vec.push_back(inserted);
+        update_timer.Start();
+        RepairInsertions(g, parent_array, batch);
+        update_timer.Stop();
+        PrintTime("Repair Time", update_timer.Seconds());
+        repair_times_vec.push_back(update_timer.Seconds());
+        update_seconds += update_timer.Seconds();
+        return Parents(parent_array);
+    };
+
+    auto VerifierBound = [source_id, &cli](const DGraph &g, const pvector<NodeID> &parent)
+    {
+        return BFSVerifier(g, source_id, parent, cli.verify_samples());
+    };
+
+    PrintAligned("Threads", omp_get_max_threads());
+    PrintLabel("Queue", QUEUE_TYPE);
+    PrintAligned("Batch Size", cli.batch_size());
+    PrintAligned("Delete Size", cli.delete_size());
+    auto structured_output = BenchmarkKernelWithStructuredOutput(cli, g, UpdateBound, PrintBFSStats<DGraph>, VerifierBound,
+                                                                 [&](double) { return update_seconds; });
+
+    if (cli.structured_output()) {
+        auto runs = structured_output["run_details"];
+        structured_output["queue"] = QUEUE_TYPE;
+        structured_output["batch_size"] = cli.batch_size();
+        structured_output["delete_size"] = cli.delete_size();
+        structured_output["source"] = source_id;
+        structured_output["initial_time"] = initial_seconds;
+        for (size_t i = 0; i < insert_times_vec.size(); i++) {
+            auto run = runs[i];
+            run["inserted_edges"] = inserted_edges_vec[i];
+            run["insert_time"] = insert_times_vec[i];
+            run["repair_time"] = repair_times_vec[i];
+            if (cli.delete_size() > 0) {
+                run["deleted_edges"] = deleted_edges_vec[i];
+                run["delete_time"] = delete_times_vec[i];
+                run["delete_repair_time"] = delete_repair_times_vec[i];
+                run["reset_vertices"] = reset_vertices_vec[i];
+            }
+            runs[i] = run;
+        }
+        structured_output["run_details"] = runs;
+        WriteJsonToFile(cli.output_name(), structured_output);
+    }
+
+    return 0;
+}
@@ -0,0 +1,402 @@
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <atomic>
+
+#include "../benchmark.h"
+#include "../bitmap.h"
+#include "../builder.h"
+#include "../command_line.h"
+#include "../graph.h"
+#include "../platform_atomics.h"
+#include "../pvector.h"
+#include "../util.h"
+#include "../json.h"
+#include "bfs_helper.h"
+#include "node.h"
+#include "queues/queues.h"
+#include <boost/lockfree/queue.hpp>
+#include <chrono>
+#include <omp.h>
+
+using json = nlohmann::json;
+
+/*
+Hybrid relaxed / bottom-up BFS
+
+Runs the batched relaxed top-down traversal on the concurrent queue and
+tracks an estimate of the edges leaving the current frontier: the summed
+out-degree of vertices that have been discovered but not yet expanded. Once
+that estimate exceeds edges_to_check / HYBRID_ALPHA (as in DOBFS), the relaxed
+phase is stopped and bulk bottom-up sweeps are run until the frontier shrinks
+below num_nodes / HYBRID_BETA. The frontier after the last sweep seeds the
+queue and the relaxed phase continues.
+
+Switching is safe because of the label-correcting invariant: if d_min is the
+smallest depth of any vertex still in the queue, every vertex whose true depth
+is <= d_min already carries its final depth. Level d_min is therefore a
+complete and correct frontier, and every vertex with a larger tentative depth
+is reset to unvisited so the sweeps can rediscover it at its true depth.
+*/
+
+#ifndef HYBRID_ALPHA
+    #define HYBRID_ALPHA 15
+#endif
+
+#ifndef HYBRID_BETA
+    #define HYBRID_BETA 18
+#endif
+
+std::vector<uint64_t> source_node_vec;
+std::vector<uint64_t> nodes_visited_vec;
+std::vector<uint64_t> nodes_revisited_vec;
+std::vector<uint64_t> enqueues_saved_vec;
+std::vector<std::vector<double>> idle_times_vec;
+std::vector<uint64_t> bottom_up_steps_vec;
+
+int64_t BUStep(const Graph &g, pvector<Node> &parent_array, uint32_t depth,
+               Bitmap &front, Bitmap &next) {
+    int64_t awake_count = 0;
+    next.reset();
+    #pragma omp parallel for reduction(+ : awake_count) schedule(dynamic, 1024)
+    for (NodeID u = 0; u < g.num_nodes(); u++) {
+        if (parent_array[u].depth == MAX_DEPTH) {
+            for (NodeID v : g.in_neigh(u)) {
+                if (front.get_bit(v)) {
+                    parent_array[u] = {v, depth + 1};
+                    awake_count++;
+                    next.set_bit(u);
+                    break;
+                }
+            }
+        }
+    }
+    return awake_count;
+}
+
+pvector<NodeID> ConcurrentBFS(const Graph &g, NodeID source_id, bool logging_enabled = false, bool structured_output = false)
+{
+    #ifdef DEBUG
+    uint64_t nodes_revisited_local = 0;
+    uint64_t nodes_revisited_total = 0;
+    uint64_t nodes_visited_local = 0;
+    uint64_t nodes_visited_total = 0;
+    uint64_t enqueues_saved_local = 0;
+    uint64_t enqueues_saved_total = 0;
+    uint64_t bottom_up_steps = 0;
+    if (logging_enabled) {
+        PrintAligned("Source", source_id);
+    }
+    source_node_vec.push_back(source_id);
+    #endif
+
+    // Seeds the queue, only SEQ_START and the queues that take a thread id read it
+    [[maybe_unused]] int thread_id = omp_get_thread_num();
+
+    pvector<Node> parent_array = pvector<Node>(g.num_nodes());
+    QUEUE(NodeIdArray);
+    parent_array[source_id] = {source_id, 0};
+
+    #ifdef SEQ_START
+        SequentialStart(g, parent_array, queue, source_id, thread_id, SEQ_START);
+    #endif
+    #ifndef SEQ_START
+    #define SEQ_START 0
+    NodeIdArray source;
+    source[0] = source_id;
+    source[1] = -1;
+    ENQUEUE(source);
+    #endif
+
+    Bitmap front(g.num_nodes());
+    Bitmap curr(g.num_nodes());
+    // Edges leaving the queued vertices and edges of still undiscovered
+    // vertices, the counterparts of scout_count and edges_to_check in DOBFS
+    std::atomic<int64_t> frontier_edges{g.out_degree(source_id)};
+    std::atomic<int64_t> edges_to_check{g.num_edges_directed() - g.out_degree(source_id)};
+    std::atomic<bool> switch_to_bottom_up{false};
+    #ifdef DEBUG
+    std::vector<double> idle_seconds(omp_get_max_threads(), 0);
+    #endif
+
+    while (true) {
+        termination_detection::TerminationDetection termination_detection(omp_get_max_threads());
+
+        #ifdef DEBUG
+        #pragma omp parallel private(nodes_revisited_local, nodes_visited_local, enqueues_saved_local)
+        #endif
+        #ifndef DEBUG
+        #pragma omp parallel
+        #endif
+        {
+            NodeIdArray dequeue_array;
+            NodeIdArray enqueue_array;
+
+            [[maybe_unused]] int thread_id = omp_get_thread_num();
+            #ifdef DEBUG
+            nodes_revisited_local = 0;
+            nodes_visited_local = 0;
+            enqueues_saved_local = 0;
+            #endif
+
+            // Once a switch is requested every thread stops dequeuing, which
+            // lets the termination detection act as the barrier between phases
+            while (termination_detection.repeat([&]() {
+                return !switch_to_bottom_up.load(std::memory_order_relaxed) &&
+                       DEQUEUE(dequeue_array);
+            })) {
+
+                uint8_t enqueue_counter = 0;
+                int64_t frontier_edges_delta = 0;
+                int64_t edges_discovered = 0;
+
+                for (NodeID node_id : dequeue_array) {
+
+                    if (node_id == -1) {
+                        break;
+                    }
+
+                    #ifdef DEBUG
+                    nodes_visited_local += 1;
+                    #endif
+
+                    Node node = parent_array[node_id];
+                    uint32_t new_depth = node.depth + 1;
+                    frontier_edges_delta -= g.out_degree(node_id);
+
+                    for (NodeID neighbor_id : g.out_neigh(node_id)) {
+                        Node neighbor = parent_array[neighbor_id];
+                        while (new_depth < neighbor.depth) {
+                            #ifdef DEBUG
+                            if (neighbor.depth != MAX_DEPTH)
+                            {
+                                nodes_revisited_local += 1;
+                            }
+                            #endif
+                            Node updated_node = {node_id, new_depth};
+                            if (compare_and_swap(parent_array[neighbor_id], neighbor, updated_node)) {
+                                if (neighbor.depth == MAX_DEPTH) {
+                                    edges_discovered += g.out_degree(neighbor_id);
+                                }
+                                #ifdef LEAF_DEGREE
+                                if (IsSettledLeaf(g, parent_array, neighbor_id, new_depth)) {
+                                    #ifdef DEBUG
+                                    enqueues_saved_local += 1;
+                                    #endif
+                                    break;
+                                }
+                                #endif
+                                frontier_edges_delta += g.out_degree(neighbor_id);
+                                enqueue_array[enqueue_counter] = neighbor_id;
+                                if (enqueue_counter >= BATCH_SIZE - 1) {
+                                    ENQUEUE(enqueue_array);
+                                    enqueue_array = NodeIdArray();
+                                    enqueue_counter = 0;
+                                } else {
+                                    enqueue_counter++;
+                                }
+                                break;
+                            }
+                            neighbor = parent_array[neighbor_id];
+                        }
+                    }
+                }
+
+                if (enqueue_counter > 0) {
+                    enqueue_array[enqueue_counter] = -1;
+                    ENQUEUE(enqueue_array);
+                }
+
+                int64_t scout_count = frontier_edges.fetch_add(frontier_edges_delta, std::memory_order_relaxed) + frontier_edges_delta;
+                int64_t remaining = edges_to_check.fetch_sub(edges_discovered, std::memory_order_relaxed) - edges_discovered;
+                if (scout_count > remaining / HYBRID_ALPHA) {
+                    switch_to_bottom_up.store(true, std::memory_order_relaxed);
+                }
+            }
+
+            #ifdef DEBUG
+            #pragma omp atomic
+            nodes_revisited_total += nodes_revisited_local;
+            #pragma omp atomic
+            nodes_visited_total += nodes_visited_local;
+            #pragma omp atomic
+            enqueues_saved_total += enqueues_saved_local;
+            #endif
+        }
+        #ifdef DEBUG
+        std::vector<double> phase_idle_seconds = termination_detection.idle_seconds();
+        for (size_t i = 0; i < idle_seconds.size(); i++) {
+            idle_seconds[i] += phase_idle_seconds[i];
+        }
+        #endif
+
+        if (!switch_to_bottom_up.load()) {
+            break;
+        }
+
+        // Drain the queue, the smallest queued depth bounds the settled levels
+        uint32_t min_depth = MAX_DEPTH;
+        #pragma omp parallel reduction(min : min_depth)
+        {
+            [[maybe_unused]] int thread_id = omp_get_thread_num();
+            NodeIdArray dequeue_array;
+            while (DEQUEUE(dequeue_array)) {
+                for (NodeID node_id : dequeue_array) {
+                    if (node_id == -1) {
+                        break;
+                    }
+                    min_depth = std::min(min_depth, parent_array[node_id].depth);
+                }
+            }
+        }
+        if (min_depth == MAX_DEPTH) {
+            break;
+        }
+
+        // Level min_depth becomes the frontier, deeper tentative depths are discarded
+        int64_t awake_count = 0;
+        front.reset();
+        #pragma omp parallel for reduction(+ : awake_count)
+        for (NodeID n = 0; n < g.num_nodes(); n++) {
+            uint32_t depth = parent_array[n].depth;
+            if (depth == min_depth) {
+                front.set_bit_atomic(n);
+                awake_count++;
+            } else if (depth > min_depth && depth != MAX_DEPTH) {
+                parent_array[n] = Node();
+            }
+        }
+
+        uint32_t depth = min_depth;
+        int64_t old_awake_count;
+        do {
+            old_awake_count = awake_count;
+            awake_count = BUStep(g, parent_array, depth, front, curr);
+            front.swap(curr);
+            depth++;
+            #ifdef DEBUG
+            bottom_up_steps++;
+            #endif
+        } while ((awake_count >= old_awake_count) ||
+                 (awake_count > g.num_nodes() / HYBRID_BETA));
+        if (awake_count == 0) {
+            break;
+        }
+
+        // Seed the queue from the frontier and reset the switching estimates
+        int64_t new_frontier_edges = 0;
+        int64_t visited_edges = 0;
+        #pragma omp parallel reduction(+ : new_frontier_edges, visited_edges)
+        {
+            [[maybe_unused]] int thread_id = omp_get_thread_num();
+            NodeIdArray enqueue_array;
+            uint8_t enqueue_counter = 0;
+            #pragma omp for nowait
+            for (NodeID n = 0; n < g.num_nodes(); n++) {
+                if (parent_array[n].depth != MAX_DEPTH) {
+                    visited_edges += g.out_degree(n);
+                }
+                if (front.get_bit(n)) {
+                    new_frontier_edges += g.out_degree(n);
+                    enqueue_array[enqueue_counter] = n;
+                    if (enqueue_counter >= BATCH_SIZE - 1) {
+                        ENQUEUE(enqueue_array);
+                        enqueue_array = NodeIdArray();
+                        enqueue_counter = 0;
+                    } else {
+                        enqueue_counter++;
+                    }
+                }
+            }
+            if (enqueue_counter > 0) {
+                enqueue_array[enqueue_counter] = -1;
+                ENQUEUE(enqueue_array);
+            }
+        }
+        frontier_edges = new_frontier_edges;
+        edges_to_check = g.num_edges_directed() - visited_edges;
+        switch_to_bottom_up = false;
+    }
+
+    pvector<NodeID> result(parent_array.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < parent_array.size(); i++) {
+        result[i] = parent_array[i].parent;
+    }
+    #ifdef DEBUG
+    if (logging_enabled) {
+        PrintAligned("Seq-Start", SEQ_START);
+        PrintAligned("Nodes visited", nodes_visited_total);
+        PrintAligned("Nodes revisited", nodes_revisited_total);
+        PrintAligned("Enqueues saved", enqueues_saved_total);
+        PrintIdleTimes(idle_seconds);
+        PrintAligned("Bottom-up steps", bottom_up_steps);
+    }
+    nodes_visited_vec.push_back(nodes_visited_total);
+    nodes_revisited_vec.push_back(nodes_revisited_total);
+    enqueues_saved_vec.push_back(enqueues_saved_total);
+    idle_times_vec.push_back(idle_seconds);
+    bottom_up_steps_vec.push_back(bottom_up_steps);
+    #endif
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    CLBFSApp cli(argc, argv, "Concurrent BFS Hybrid Bottom-Up");
+
+    if (!cli.ParseArgs()) {
+        printf("Exiting");
+        return -1;
+    }
+    Builder b(cli);
+    Graph g = b.MakeGraph();
+
+    // Pick start-vertex in BFS graph traversal
+    SourcePicker<Graph> sp(g, cli.start_vertex());
+
+    auto BFSBound = [&sp, &cli](const Graph &g)
+    {
+        return ConcurrentBFS(g, sp.PickNext(), cli.logging_en());
+    };
+
+    SourcePicker<Graph> vsp(g, cli.start_vertex());
+    auto VerifierBound = [&vsp, &cli](const Graph &g, const pvector<NodeID> &parent)
+    {
+        return BFSVerifier(g, vsp.PickNext(), parent, cli.verify_samples());
+    };
+
+    PrintAligned("Threads", omp_get_max_threads());
+    PrintLabel("Queue", QUEUE_TYPE);
+    #ifdef LEAF_DEGREE
+    PrintAligned("Leaf Degree", LEAF_DEGREE);
+    #endif
+    PrintAligned("Batch Size", BATCH_SIZE);
+    PrintAligned("Alpha", HYBRID_ALPHA);
+    PrintAligned("Beta", HYBRID_BETA);
+    auto structured_output = BenchmarkKernelWithStructuredOutput(cli, g, BFSBound, PrintBFSStats<Graph>, VerifierBound);
+
+    if (cli.structured_output()) {
+        auto runs = structured_output["run_details"];
+        structured_output["queue"] = QUEUE_TYPE;
+        structured_output["seq_start"] = SEQ_START;
+        #ifdef LEAF_DEGREE
+        structured_output["leaf_degree"] = LEAF_DEGREE;
+        #endif
+        structured_output["alpha"] = HYBRID_ALPHA;
+        structured_output["beta"] = HYBRID_BETA;
+        for (size_t i = 0; i < source_node_vec.size(); i++) {
+            auto run = runs[i];
+            run["nodes_visited"] = nodes_visited_vec[i];
+            run["nodes_revisited"] = nodes_revisited_vec[i];
+            run["enqueues_saved"] = enqueues_saved_vec[i];
+            run["idle_times"] = idle_times_vec[i];
+            run["bottom_up_steps"] = bottom_up_steps_vec[i];
+            run["source"] = source_node_vec[i];
+            runs[i] = run;
+        }
+        structured_output["run_details"] = runs;
+        WriteJsonToFile(cli.output_name(), structured_output);
+    }
+
+    return 0;
+}
@@ -0,0 +1,333 @@
+#include <iostream>
+#include <vector>
+#include <queue>
+
+#include "../benchmark.h"
+#include "../bitmap.h"
+#include "../builder.h"
+#include "../command_line.h"
+#include "../graph.h"
+#include "../platform_atomics.h"
+#include "../pvector.h"
+#include "../util.h"
+#include "../json.h"
+#include "bfs_helper.h"
+#include "node.h"
+#include "queues/queues.h"
+#include <boost/lockfree/queue.hpp>
+#include <chrono>
+#include <omp.h>
+
+using json = nlohmann::json;
+
+/*
+Relaxed BFS with a thread-local work buffer
+
+Generalizes the pre-dequeue comparison of rbfs_dad/rbfs_bod. Each thread keeps
+the vertices it discovers in a small private FIFO ring and expands from it
+while
+ - fewer than LOCAL_BUDGET vertices have been expanded in this round, and
+ - the depth at the head of the ring is not larger than the depth of a batch
+   sampled from the shared queue with SINGLE_DEQUEUE
+Afterwards the remainder of the ring is spilled to the shared queue in full
+batches and the sampled batch starts the next round. Since the ring is FIFO
+and filled by expanding it in order, its head holds its minimum depth.
+Vertices that do not fit into the ring are published immediately.
+*/
+
+#ifndef LOCAL_RING_SIZE
+    #define LOCAL_RING_SIZE 128
+#endif
+
+#ifndef LOCAL_BUDGET
+    #define LOCAL_BUDGET 64
+#endif
+
+std::vector<uint64_t> source_node_vec;
+std::vector<uint64_t> nodes_visited_vec;
+std::vector<uint64_t> nodes_revisited_vec;
+std::vector<uint64_t> enqueues_saved_vec;
+std::vector<std::vector<double>> idle_times_vec;
+
+template <int Capacity>
+class LocalRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "LOCAL_RING_SIZE must be a power of two");
+    std::array<NodeID, Capacity> ring_;
+    uint32_t head_ = 0;
+    uint32_t tail_ = 0;
+
+   public:
+    bool empty() const { return head_ == tail_; }
+    bool full() const { return tail_ - head_ == Capacity; }
+    NodeID front() const { return ring_[head_ & (Capacity - 1)]; }
+    void push(NodeID node_id) { ring_[tail_++ & (Capacity - 1)] = node_id; }
+    NodeID pop() { return ring_[head_++ & (Capacity - 1)]; }
+};
+
+pvector<NodeID> ConcurrentBFS(const Graph &g, NodeID source_id, bool logging_enabled = false, bool structured_output = false)
+{
+    #ifdef DEBUG
+    uint64_t nodes_revisited_local = 0;
+    uint64_t nodes_revisited_total = 0;
+    uint64_t nodes_visited_local = 0;
+    uint64_t nodes_visited_total = 0;
+    uint64_t enqueues_saved_local = 0;
+    uint64_t enqueues_saved_total = 0;
+    if (logging_enabled) {
+        PrintAligned("Source", source_id);
+    }
+    source_node_vec.push_back(source_id);
+    #endif
+
+    // Seeds the queue, only SEQ_START and the queues that take a thread id read it
+    [[maybe_unused]] int thread_id = omp_get_thread_num();
+
+    pvector<Node> parent_array = pvector<Node>(g.num_nodes());
+    QUEUE(NodeIdArray);
+    parent_array[source_id] = {source_id, 0};
+
+    #ifdef SEQ_START
+        SequentialStart(g, parent_array, queue, source_id, thread_id, SEQ_START);
+    #endif
+    #ifndef SEQ_START
+    #define SEQ_START 0
+    NodeIdArray source;
+    source[0] = source_id;
+    source[1] = -1;
+    ENQUEUE(source);
+    #endif
+
+    termination_detection::TerminationDetection termination_detection(omp_get_max_threads());
+
+    #ifdef DEBUG
+    #pragma omp parallel private(nodes_revisited_local, nodes_visited_local, enqueues_saved_local)
+    #endif
+    #ifndef DEBUG
+    #pragma omp parallel
+    #endif
+    {
+        LocalRing<LOCAL_RING_SIZE> ring;
+        NodeIdArray dequeue_array;
+        NodeIdArray sample_array = NodeIdArray();
+        NodeIdArray enqueue_array;
+        uint8_t enqueue_counter = 0;
+        bool have_sample = false;
+        #ifdef DEBUG
+        // The ring is only refilled from the shared queue when it is empty,
+        // so the vertices that came from the queue are at its front
+        uint32_t from_queue = 0;
+        #endif
+
+        [[maybe_unused]] int thread_id = omp_get_thread_num();
+        #ifdef DEBUG
+        nodes_revisited_local = 0;
+        nodes_visited_local = 0;
+        enqueues_saved_local = 0;
+        #endif
+
+        auto publish = [&](NodeID node_id) {
+            enqueue_array[enqueue_counter] = node_id;
+            if (enqueue_counter >= BATCH_SIZE - 1) {
+                ENQUEUE(enqueue_array);
+                enqueue_array = NodeIdArray();
+                enqueue_counter = 0;
+            } else {
+                enqueue_counter++;
+            }
+        };
+
+        auto fill_ring = [&](const NodeIdArray &batch) {
+            for (NodeID node_id : batch) {
+                if (node_id == -1) {
+                    break;
+                }
+                if (ring.full()) {
+                    publish(node_id);
+                } else {
+                    #ifdef DEBUG
+                    from_queue += 1;
+                    #endif
+                    ring.push(node_id);
+                }
+            }
+        };
+
+        while (termination_detection.repeat([&]() {
+            if (!ring.empty()) {
+                return true;
+            }
+            if (DEQUEUE(dequeue_array)) {
+                fill_ring(dequeue_array);
+                return true;
+            }
+            return false;
+        })) {
+
+            // Sample the shared queue to bound the depths expanded privately
+            uint32_t sampled_depth = MAX_DEPTH;
+            have_sample = SINGLE_DEQUEUE(sample_array);
+            if (have_sample) {
+                sampled_depth = parent_array[sample_array[0]].depth;
+            }
+
+            for (int budget = LOCAL_BUDGET; budget > 0 && !ring.empty(); budget--) {
+                if (parent_array[ring.front()].depth > sampled_depth) {
+                    break;
+                }
+                NodeID node_id = ring.pop();
+
+                #ifdef DEBUG
+                nodes_visited_local += 1;
+                if (from_queue > 0) {
+                    from_queue -= 1;
+                }
+                #endif
+
+                Node node = parent_array[node_id];
+                uint32_t new_depth = node.depth + 1;
+
+                for (NodeID neighbor_id : g.out_neigh(node_id)) {
+                    Node neighbor = parent_array[neighbor_id];
+                    while (new_depth < neighbor.depth) {
+                        #ifdef DEBUG
+                        if (neighbor.depth != MAX_DEPTH)
+                        {
+                            nodes_revisited_local += 1;
+                        }
+                        #endif
+                        Node updated_node = {node_id, new_depth};
+                        if (compare_and_swap(parent_array[neighbor_id], neighbor, updated_node)) {
+                            #ifdef LEAF_DEGREE
+                            if (IsSettledLeaf(g, parent_array, neighbor_id, new_depth)) {
+                                #ifdef DEBUG
+                                enqueues_saved_local += 1;
+                                #endif
+                                break;
+                            }
+                            #endif
+                            if (ring.full()) {
+                                publish(neighbor_id);
+                            } else {
+                                #ifdef DEBUG
+                                enqueues_saved_local += 1;
+                                #endif
+                                ring.push(neighbor_id);
+                            }
+                            break;
+                        }
+                        neighbor = parent_array[neighbor_id];
+                    }
+                }
+            }
+
+            // Spill the remainder in bulk, the sample starts the next round
+            while (!ring.empty()) {
+                #ifdef DEBUG
+                if (from_queue > 0) {
+                    from_queue -= 1;
+                } else {
+                    enqueues_saved_local -= 1;
+                }
+                #endif
+                publish(ring.pop());
+            }
+            if (enqueue_counter > 0) {
+                enqueue_array[enqueue_counter] = -1;
+                ENQUEUE(enqueue_array);
+                enqueue_array = NodeIdArray();
+                enqueue_counter = 0;
+            }
+            if (have_sample) {
+                fill_ring(sample_array);
+            }
+        }
+
+        #ifdef DEBUG
+        #pragma omp atomic
+        nodes_revisited_total += nodes_revisited_local;
+        #pragma omp atomic
+        nodes_visited_total += nodes_visited_local;
+        #pragma omp atomic
+        enqueues_saved_total += enqueues_saved_local;
+        #endif
+    }
+
+    pvector<NodeID> result(parent_array.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < parent_array.size(); i++) {
+        result[i] = parent_array[i].parent;
+    }
+    #ifdef DEBUG
+    if (logging_enabled) {
+        PrintAligned("Seq-Start", SEQ_START);
+        PrintAligned("Nodes visited", nodes_visited_total);
+        PrintAligned("Nodes revisited", nodes_revisited_total);
+        PrintAligned("Enqueues saved", enqueues_saved_total);
+        PrintIdleTimes(termination_detection.idle_seconds());
+    }
+    nodes_visited_vec.push_back(nodes_visited_total);
+    nodes_revisited_vec.push_back(nodes_revisited_total);
+    enqueues_saved_vec.push_back(enqueues_saved_total);
+    idle_times_vec.push_back(termination_detection.idle_seconds());
+    #endif
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    CLBFSApp cli(argc, argv, "Concurrent BFS Local Work Buffer");
+
+    if (!cli.ParseArgs()) {
+        printf("Exiting");
+        return -1;
+    }
+    Builder b(cli);
+    Graph g = b.MakeGraph();
+
+    // Pick start-vertex in BFS graph traversal
+    SourcePicker<Graph> sp(g, cli.start_vertex());
+
+    auto BFSBound = [&sp, &cli](const Graph &g)
+    {
+        return ConcurrentBFS(g, sp.PickNext(), cli.logging_en());
+    };
+
+    SourcePicker<Graph> vsp(g, cli.start_vertex());
+    auto VerifierBound = [&vsp, &cli](const Graph &g, const pvector<NodeID> &parent)
+    {
+        return BFSVerifier(g, vsp.PickNext(), parent, cli.verify_samples());
+    };
+
+    PrintAligned("Threads", omp_get_max_threads());
+    PrintLabel("Queue", QUEUE_TYPE);
+    #ifdef LEAF_DEGREE
+    PrintAligned("Leaf Degree", LEAF_DEGREE);
+    #endif
+    PrintAligned("Batch Size", BATCH_SIZE);
+    PrintAligned("Local Ring Size", LOCAL_RING_SIZE);
+    PrintAligned("Local Budget", LOCAL_BUDGET);
+    auto structured_output = BenchmarkKernelWithStructuredOutput(cli, g, BFSBound, PrintBFSStats<Graph>, VerifierBound);
+
+    if (cli.structured_output()) {
+        auto runs = structured_output["run_details"];
+        structured_output["queue"] = QUEUE_TYPE;
+        structured_output["seq_start"] = SEQ_START;
+        #ifdef LEAF_DEGREE
+        structured_output["leaf_degree"] = LEAF_DEGREE;
+        #endif
+        structured_output["local_ring_size"] = LOCAL_RING_SIZE;
+        structured_output["local_budget"] = LOCAL_BUDGET;
+        for (size_t i = 0; i < source_node_vec.size(); i++) {
+            auto run = runs[i];
+            run["nodes_visited"] = nodes_visited_vec[i];
+            run["nodes_revisited"] = nodes_revisited_vec[i];
+            run["enqueues_saved"] = enqueues_saved_vec[i];
+            run["idle_times"] = idle_times_vec[i];
+            run["source"] = source_node_vec[i];
+            runs[i] = run;
+        }
+        structured_output["run_details"] = runs;
+        WriteJsonToFile(cli.output_name(), structured_output);
+    }
+
+    return 0;
+}
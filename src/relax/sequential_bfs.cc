@@ -89,11 +89,11 @@ int main(int argc, char* argv[])
     };
 
     SourcePicker<Graph> vsp(g, cli.start_vertex());
-    auto VerifierBound = [&vsp] (const Graph &g, const pvector<NodeID> &parent) {
-        return BFSVerifier(g, vsp.PickNext(), parent);
+    auto VerifierBound = [&vsp, &cli] (const Graph &g, const pvector<NodeID> &parent) {
+        return BFSVerifier(g, vsp.PickNext(), parent, cli.verify_samples());
     };
 
-    auto structured_output = BenchmarkKernelWithStructuredOutput(cli, g, BFSBound, PrintBFSStats, VerifierBound);
+    auto structured_output = BenchmarkKernelWithStructuredOutput(cli, g, BFSBound, PrintBFSStats<Graph>, VerifierBound);
 
     if (cli.structured_output()) {
         auto runs = structured_output["run_details"];
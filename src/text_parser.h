@@ -0,0 +1,130 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef TEXT_PARSER_H_
+#define TEXT_PARSER_H_
+
+#include <charconv>
+#include <cinttypes>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+
+/*
+GAP Benchmark Suite
+Class:  TextCursor
+
+Parses numbers out of a block of text (e.g., part of a mapped file)
+ - Parse skips whitespace first and stops after the number, like operator>>
+ - Returns false without consuming anything but whitespace if no number of
+   the requested type starts there (including overflow)
+ - Integers are parsed eight digits at a time where possible
+*/
+
+
+class TextCursor {
+ public:
+  TextCursor(const char* begin, const char* end) : pos_(begin), end_(end) {}
+
+  bool done() const { return pos_ == end_; }
+
+  char peek() const { return *pos_; }
+
+  void Skip(size_t num_chars) { pos_ += num_chars; }
+
+  void SkipSpace() {
+    while ((pos_ < end_) && IsSpace(*pos_))
+      pos_++;
+  }
+
+  // Moves past the next newline (or to the end)
+  void SkipLine() {
+    const void* newline = std::memchr(pos_, '\n', end_ - pos_);
+    pos_ = newline ? static_cast<const char*>(newline) + 1 : end_;
+  }
+
+  template <typename T_>
+  typename std::enable_if<std::is_integral<T_>::value, bool>::type
+  Parse(T_ &value) {
+    SkipSpace();
+    const char* start = pos_;
+    bool negative = false;
+    if ((pos_ < end_) && ((*pos_ == '-') || (*pos_ == '+'))) {
+      negative = *pos_ == '-';
+      pos_++;
+    }
+    const char* digits = pos_;
+    uint64_t magnitude = 0;
+    uint64_t eight;
+    while ((end_ - pos_ >= 8) && (pos_ - digits <= 8) &&
+           EightDigits(pos_, eight)) {
+      magnitude = magnitude * 100000000 + eight;
+      pos_ += 8;
+    }
+    while ((pos_ < end_) && IsDigit(*pos_) && (pos_ - digits < 19)) {
+      magnitude = magnitude * 10 + (*pos_ - '0');
+      pos_++;
+    }
+    bool valid = (pos_ != digits) && !((pos_ < end_) && IsDigit(*pos_));
+    if (negative) {
+      valid = valid && std::is_signed<T_>::value &&
+              (magnitude <= static_cast<uint64_t>(
+                 std::numeric_limits<T_>::max()) + 1);
+      value = static_cast<T_>(0 - magnitude);
+    } else {
+      valid = valid && (magnitude <= static_cast<uint64_t>(
+                          std::numeric_limits<T_>::max()));
+      value = static_cast<T_>(magnitude);
+    }
+    if (!valid)
+      pos_ = start;
+    return valid;
+  }
+
+  template <typename T_>
+  typename std::enable_if<std::is_floating_point<T_>::value, bool>::type
+  Parse(T_ &value) {
+    SkipSpace();
+    const char* start = pos_;
+    if ((pos_ < end_) && (*pos_ == '+'))
+      pos_++;
+    auto result = std::from_chars(pos_, end_, value);
+    if (result.ec != std::errc()) {
+      pos_ = start;
+      return false;
+    }
+    pos_ = result.ptr;
+    return true;
+  }
+
+ private:
+  static bool IsSpace(char c) {
+    return (c == ' ') || (static_cast<unsigned char>(c - '\t') <= '\r' - '\t');
+  }
+
+  static bool IsDigit(char c) {
+    return static_cast<unsigned char>(c - '0') < 10;
+  }
+
+  // Converts 8 ASCII digits at p without branches (little endian)
+  static bool EightDigits(const char* p, uint64_t &value) {
+    uint64_t chunk;
+    std::memcpy(&chunk, p, sizeof(chunk));
+    if ((((chunk & 0xF0F0F0F0F0F0F0F0) |
+          (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4))) !=
+        0x3333333333333333)
+      return false;
+    chunk -= 0x3030303030303030;
+    chunk = (chunk * 10) + (chunk >> 8);
+    value = (((chunk & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) +
+             (((chunk >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32))))
+            >> 32;
+    return true;
+  }
+
+  const char* pos_;
+  const char* end_;
+};
+
+#endif  // TEXT_PARSER_H_
@@ -0,0 +1,122 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef TRIAL_STATS_H_
+#define TRIAL_STATS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "util.h"
+
+
+/*
+GAP Benchmark Suite
+Class:  TrialStats
+
+Summarizes the times of the measured trials of a kernel
+ - Order statistics (median, p10/p90/p99) interpolate linearly between the
+   sorted times, so they stay meaningful for a handful of trials
+ - Confidence intervals are percentile bootstraps: the median (or mean) is
+   recomputed on kNumResamples resamples drawn with replacement, and the
+   interval covers the middle kConfidence of those estimates
+ - Resampling is seeded with kRandSeed, so the same times always give the
+   same intervals
+*/
+
+
+class TrialStats {
+ public:
+  static const int kNumResamples = 1000;
+  static constexpr double kConfidence = 0.95;
+
+  explicit TrialStats(const std::vector<double> &times)
+      : times_(times), sorted_(times) {
+    std::sort(sorted_.begin(), sorted_.end());
+  }
+
+  size_t size() const { return times_.size(); }
+
+  double Mean() const { return Mean(times_); }
+
+  double Median() const { return Percentile(0.5); }
+
+  // Sample standard deviation
+  double StdDev() const {
+    if (times_.size() < 2)
+      return 0;
+    double mean = Mean();
+    double sum_sq = 0;
+    for (double t : times_)
+      sum_sq += (t - mean) * (t - mean);
+    return std::sqrt(sum_sq / (times_.size() - 1));
+  }
+
+  double Min() const { return sorted_.front(); }
+
+  double Max() const { return sorted_.back(); }
+
+  // p in [0, 1]
+  double Percentile(double p) const { return Percentile(sorted_, p); }
+
+  std::pair<double, double> MedianCI() const {
+    return Bootstrap([](std::vector<double> &resample) {
+      std::sort(resample.begin(), resample.end());
+      return Percentile(resample, 0.5);
+    });
+  }
+
+  std::pair<double, double> MeanCI() const {
+    return Bootstrap([](std::vector<double> &resample) {
+      return Mean(resample);
+    });
+  }
+
+  // Width of the median's confidence interval relative to the median
+  double RelativeMedianCIWidth() const {
+    std::pair<double, double> ci = MedianCI();
+    return (ci.second - ci.first) / Median();
+  }
+
+ private:
+  static double Mean(const std::vector<double> &times) {
+    double total = 0;
+    for (double t : times)
+      total += t;
+    return total / times.size();
+  }
+
+  static double Percentile(const std::vector<double> &sorted, double p) {
+    double pos = p * (sorted.size() - 1);
+    size_t below = static_cast<size_t>(pos);
+    if (below + 1 >= sorted.size())
+      return sorted.back();
+    double frac = pos - below;
+    return sorted[below] + frac * (sorted[below + 1] - sorted[below]);
+  }
+
+  template <typename EstimatorFunc>
+  std::pair<double, double> Bootstrap(EstimatorFunc estimate) const {
+    std::mt19937_64 rng(kRandSeed);
+    std::uniform_int_distribution<size_t> pick(0, times_.size() - 1);
+    std::vector<double> estimates(kNumResamples);
+    std::vector<double> resample(times_.size());
+    for (int r = 0; r < kNumResamples; r++) {
+      for (double &t : resample)
+        t = times_[pick(rng)];
+      estimates[r] = estimate(resample);
+    }
+    std::sort(estimates.begin(), estimates.end());
+    double tail = (1 - kConfidence) / 2;
+    return std::make_pair(Percentile(estimates, tail),
+                          Percentile(estimates, 1 - tail));
+  }
+
+  std::vector<double> times_;
+  std::vector<double> sorted_;
+};
+
+#endif  // TRIAL_STATS_H_
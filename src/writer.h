@@ -4,13 +4,20 @@
 #ifndef WRITER_H_
 #define WRITER_H_
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <type_traits>
 
+#include "compressed_graph.h"
 #include "graph.h"
+#include "mapped_file.h"
+#include "pvector.h"
 
 
 /*
@@ -20,10 +27,48 @@ Author: Scott Beamer
 
 Given filename and graph, writes out the graph to storage
  - Should use WriteGraph(filename, serialized)
- - If serialized, will write out as serialized graph, otherwise, as edgelist
+ - If serialized, will write out as serialized graph (v2, sections written
+   in parallel), otherwise, as edgelist
+ - If compressed, will write out as compressed serialized graph (.csg)
+ - Edge lists named .bel or .wbel are written in binary (WriteBinaryEL)
+ - WriteSharedGraph(filename) publishes the serialized graph into memory
+   (tmpfs or hugetlbfs) for other processes to map (graphd)
 */
 
 
+// Writes el as binary edge list (.bel, or .wbel if weighted) in parallel
+template <typename NodeID_, typename DestID_>
+void WriteBinaryEL(std::string filename,
+                   const pvector<EdgePair<NodeID_, DestID_>> &el,
+                   int64_t num_nodes = -1) {
+  bool weighted = !std::is_same<NodeID_, DestID_>::value;
+  std::string suffix = filename.substr(std::min(filename.rfind('.'),
+                                                filename.size()));
+  if (suffix != (weighted ? ".wbel" : ".bel")) {
+    std::cout << (weighted ? "weighted" : "unweighted") << " binary edge "
+              << "lists need suffix " << (weighted ? ".wbel" : ".bel")
+              << std::endl;
+    std::exit(-8);
+  }
+  BELHeader header;
+  std::copy(kBELMagic, kBELMagic + sizeof(kBELMagic), header.magic);
+  header.id_bytes = sizeof(NodeID_);
+  header.dest_bytes = sizeof(DestID_);
+  header.num_nodes = num_nodes;
+  header.num_edges = el.size();
+  size_t el_bytes = el.size() * sizeof(EdgePair<NodeID_, DestID_>);
+  int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if ((fd == -1) || (ftruncate(fd, sizeof(header) + el_bytes) != 0) ||
+      (pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) ||
+      !ParallelPositionalIO(fd, reinterpret_cast<char*>(el.data()), el_bytes,
+                            sizeof(header), true)) {
+    std::cout << "Couldn't write to file " << filename << std::endl;
+    std::exit(-5);
+  }
+  close(fd);
+}
+
+
 template <typename NodeID_, typename DestID_ = NodeID_>
 class WriterBase {
  public:
@@ -36,9 +81,27 @@ class WriterBase {
     }
   }
 
-  void WriteSerializedGraph(std::fstream &out) {
-    if (!std::is_same<NodeID_, SGID>::value) {
-      std::cout << "serialized graphs only allowed for 32b IDs" << std::endl;
+  // Edges in CSR order, undirected edges appear in both directions
+  pvector<EdgePair<NodeID_, DestID_>> MakeEdgeList() {
+    pvector<SGOffset> offsets = g_.VertexOffsets(false);
+    pvector<EdgePair<NodeID_, DestID_>> el(offsets[g_.num_nodes()]);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (NodeID_ u=0; u < g_.num_nodes(); u++) {
+      SGOffset e = offsets[u];
+      for (DestID_ v : g_.out_neigh(u))
+        el[e++] = EdgePair<NodeID_, DestID_>(u, v);
+    }
+    return el;
+  }
+
+  // Lays out the v2 serialized graph and hands every section and finally the
+  // header (with the sections' checksums) to write(pos, data, num_bytes)
+  template <typename WriteFunc_>
+  void SerializeGraph(SGHeader header, WriteFunc_ write) {
+    if (!std::is_same<NodeID_, SGID>::value &&
+        !std::is_same<NodeID_, int64_t>::value) {
+      std::cout << "serialized graphs only allowed for 32b or 64b IDs"
+                << std::endl;
       std::exit(-4);
     }
     if (!std::is_same<DestID_, NodeID_>::value &&
@@ -46,40 +109,119 @@ class WriterBase {
       std::cout << ".wsg only allowed for int32_t weights" << std::endl;
       std::exit(-8);
     }
-    bool directed = g_.directed();
-    SGOffset num_nodes = g_.num_nodes();
-    SGOffset edges_to_write = g_.num_edges_directed();
-    std::streamsize index_bytes = (num_nodes+1) * sizeof(SGOffset);
-    std::streamsize neigh_bytes;
-    if (std::is_same<DestID_, NodeID_>::value)
-      neigh_bytes = edges_to_write * sizeof(SGID);
-    else
-      neigh_bytes = edges_to_write * sizeof(NodeWeight<NodeID_, SGID>);
-    out.write(reinterpret_cast<char*>(&directed), sizeof(bool));
-    out.write(reinterpret_cast<char*>(&edges_to_write), sizeof(SGOffset));
-    out.write(reinterpret_cast<char*>(&num_nodes), sizeof(SGOffset));
+    auto write_section = [&](int s, const void* data) {
+      SGSection &section = header.sections[s];
+      section.checksum = SGChecksum::Of(data, section.num_bytes);
+      write(section.start, data, section.num_bytes);
+    };
     pvector<SGOffset> offsets = g_.VertexOffsets(false);
-    out.write(reinterpret_cast<char*>(offsets.data()), index_bytes);
-    out.write(reinterpret_cast<char*>(g_.out_neigh(0).begin()), neigh_bytes);
-    if (directed) {
+    write_section(0, offsets.data());
+    write_section(1, g_.out_neigh(0).begin());
+    if (g_.directed()) {
       offsets = g_.VertexOffsets(true);
-      out.write(reinterpret_cast<char*>(offsets.data()), index_bytes);
-      out.write(reinterpret_cast<char*>(g_.in_neigh(0).begin()), neigh_bytes);
+      write_section(2, offsets.data());
+      write_section(3, g_.in_neigh(0).begin());
+    }
+    write(0, &header, sizeof(SGHeader));
+  }
+
+  SGHeader SerializedHeader() {
+    return MakeSGHeader(g_.directed(), g_.num_nodes(),
+                        g_.num_edges_directed(), sizeof(NodeID_),
+                        sizeof(DestID_));
+  }
+
+  // Writes every section with parallel positional writes
+  void WriteSerializedGraph(std::string filename) {
+    SGHeader header = SerializedHeader();
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool failed = (fd == -1) || (ftruncate(fd, SGFileBytes(header)) != 0);
+    if (!failed) {
+      SerializeGraph(header, [&](int64_t pos, const void* data,
+                                 size_t num_bytes) {
+        failed |= !ParallelPositionalIO(
+          fd, static_cast<char*>(const_cast<void*>(data)), num_bytes, pos,
+          true);
+      });
+    }
+    if (failed) {
+      std::cout << "Couldn't write to file " << filename << std::endl;
+      std::exit(-5);
     }
+    close(fd);
   }
 
-  void WriteGraph(std::string filename, bool serialized = false) {
+  void WriteCompressedGraph(std::fstream &out) {
+    if constexpr (!std::is_same<NodeID_, SGID>::value ||
+                  !std::is_same<DestID_, NodeID_>::value) {
+      std::cout << ".csg only allowed for unweighted 32b IDs" << std::endl;
+      std::exit(-4);
+    } else {
+      CompressedCSRGraph<NodeID_> cg(g_);
+      bool directed = cg.directed();
+      SGOffset num_nodes = cg.num_nodes();
+      SGOffset edges_to_write = cg.num_edges_directed();
+      std::streamsize index_bytes = (num_nodes+1) * sizeof(SGOffset);
+      out.write(reinterpret_cast<char*>(&directed), sizeof(bool));
+      out.write(reinterpret_cast<char*>(&edges_to_write), sizeof(SGOffset));
+      out.write(reinterpret_cast<char*>(&num_nodes), sizeof(SGOffset));
+      for (bool in_graph : {false, true}) {
+        if (in_graph && !directed)
+          break;
+        pvector<SGOffset> offsets = cg.ByteOffsets(in_graph);
+        SGOffset num_bytes = offsets[num_nodes];
+        out.write(reinterpret_cast<char*>(&num_bytes), sizeof(SGOffset));
+        out.write(reinterpret_cast<char*>(offsets.data()), index_bytes);
+        out.write(reinterpret_cast<const char*>(cg.bytes(in_graph)),
+                  num_bytes);
+      }
+    }
+  }
+
+  // Serialized graph in a shared mapping, written under a temporary name and
+  // renamed, so it appears complete or not at all
+  void WriteSharedGraph(std::string filename) {
+    SGHeader header = SerializedHeader();
+    std::string temp_filename = filename + ".tmp" + std::to_string(getpid());
+    size_t mapped_bytes;
+    char* data = CreateSharedMapping(temp_filename, SGFileBytes(header),
+                                     &mapped_bytes);
+    SerializeGraph(header, [&](int64_t pos, const void* section,
+                               size_t num_bytes) {
+      ParallelCopy(data + pos, section, num_bytes);
+    });
+    munmap(data, mapped_bytes);
+    if (std::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+      std::cout << "Couldn't publish graph as " << filename << std::endl;
+      std::remove(temp_filename.c_str());
+      std::exit(-5);
+    }
+  }
+
+  void WriteGraph(std::string filename, bool serialized = false,
+                  bool compressed = false) {
     if (filename == "") {
       std::cout << "No output filename given (Use -h for help)" << std::endl;
       std::exit(-8);
     }
+    std::string suffix = filename.substr(std::min(filename.rfind('.'),
+                                                  filename.size()));
+    if (!serialized && !compressed &&
+        ((suffix == ".bel") || (suffix == ".wbel"))) {
+      WriteBinaryEL(filename, MakeEdgeList(), g_.num_nodes());
+      return;
+    }
+    if (serialized) {
+      WriteSerializedGraph(filename);
+      return;
+    }
     std::fstream file(filename, std::ios::out | std::ios::binary);
     if (!file) {
       std::cout << "Couldn't write to file " << filename << std::endl;
       std::exit(-5);
     }
-    if (serialized)
-      WriteSerializedGraph(file);
+    if (compressed)
+      WriteCompressedGraph(file);
     else
       WriteEL(file);
     file.close();